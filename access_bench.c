@@ -0,0 +1,535 @@
+/*
+ *      access_bench.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This program times the ways the UArray2_T and Bit2_T are used one
+ *      element at a time: UArray2_at and Bit2_get / Bit2_put at sequential
+ *      and at random positions, and map_row_major against map_col_major.
+ *      Every case runs on working sets from 16 KB, which fits in the L1
+ *      cache, up to max_mb megabytes (64 by default), well past the last
+ *      level cache, and on UArray2 elements of 1, 4, 16, and 64 bytes. Each
+ *      case is run reps times (11 by default). A run makes at least 2^20
+ *      accesses, going over a small structure more than once, and is timed
+ *      in batches of 1024 accesses, so the median and 99th percentile of a
+ *      run are of its batches; the medians of those over the runs are
+ *      reported as the cost of one access. On Linux, the cycles,
+ *      instructions, last level cache misses, and branch misses of each
+ *      access are read with perf_event_open when the kernel allows it;
+ *      otherwise those columns show "-".
+ *
+ *      Usage: access_bench [reps [max_mb]]
+ */
+
+#define _GNU_SOURCE  /* for clock_gettime and syscall */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "uarray2.h"
+#include "bit2.h"
+#include "assert.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define MAX_REPS 1001
+#define RANDOM_ACCESSES (1 << 20)
+#define BATCH 1024
+
+/* the hardware counters read around each run, when they can be opened */
+enum counter { CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, NCOUNTERS };
+
+/* what the cases run on: the structure, the random positions to visit,
+ * a checksum that keeps the loops from being optimized away, and the
+ * times taken every BATCH accesses
+ */
+struct Target {
+    UArray2_T uarray2;
+    Bit2_T bit2;
+    int *xs;
+    int *ys;
+    long sum;
+    double *stamps;
+    long nstamps;
+    int left;               /* accesses until the next stamp */
+};
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+double now(void);
+void counters_open(int *fds);
+void counters_read(const int *fds, long long *values);
+void time_case(const char *structure, int size, long bytes, const char *name,
+               void run(struct Target *target), struct Target *target,
+               long accesses, int reps, const int *fds);
+int stamp(struct Target *target);
+int compare_doubles(const void *a, const void *b);
+void positions(struct Target *target, int width, int height);
+long uarray2_cases(int size, long bytes, int reps, const int *fds);
+long bit2_cases(long bytes, int reps, const int *fds);
+void at_seq(struct Target *target);
+void at_rand(struct Target *target);
+void uarray2_map_row(struct Target *target);
+void uarray2_map_col(struct Target *target);
+void touch(int i, int j, UArray2_T uarray2, void *elem, void *cl);
+void get_seq(struct Target *target);
+void get_rand(struct Target *target);
+void put_seq(struct Target *target);
+void put_rand(struct Target *target);
+void bit2_map_row(struct Target *target);
+void bit2_map_col(struct Target *target);
+void touch_bit(int i, int j, Bit2_T bit2, int bit, void *cl);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int main(int argc, char *argv[])
+{
+    static const int sizes[] = { 1, 4, 16, 64 };
+    int reps = 11, max_mb = 64;
+    if (argc >= 2) reps = atoi(argv[1]);
+    if (argc >= 3) max_mb = atoi(argv[2]);
+    if (reps <= 0 || reps > MAX_REPS || max_mb <= 0 || argc > 3) {
+        fprintf(stderr, "usage: %s [reps <= %d [max_mb]]\n", argv[0],
+                MAX_REPS);
+        exit(EXIT_FAILURE);
+    }
+
+    int fds[NCOUNTERS];
+    long bytes, sum = 0;
+    int k;
+    counters_open(fds);
+    printf("%d reps, counters %s\n", reps,
+           fds[CYCLES] >= 0 ? "per access" : "unavailable");
+    printf("%-8s %4s %8s %-14s %10s %10s %8s %8s %8s %8s\n", "struct",
+           "size", "set", "case", "median ns", "p99 ns", "cycles", "instrs",
+           "llc miss", "br miss");
+
+    /* working sets grow by 16 times, from the L1 cache to main memory */
+    for (bytes = 16 << 10; bytes <= (long)max_mb << 20; bytes *= 16) {
+        for (k = 0; k < 4; k++)
+            sum += uarray2_cases(sizes[k], bytes, reps, fds);
+        sum += bit2_cases(bytes, reps, fds);
+    }
+
+    /* printing the checksum keeps the loops from being optimized away */
+    printf("checksum %ld\n", sum);
+#ifdef __linux__
+    for (k = 0; k < NCOUNTERS; k++)
+        if (fds[k] >= 0) close(fds[k]);
+#endif
+    exit(EXIT_SUCCESS);
+}
+
+/* Purpose: uarray2_cases times every UArray2_T case on a square grid of
+ *          elements of one size that takes up a given number of bytes
+ * I: The element size, the working set in bytes, the number of runs of
+ *    each case, and the counter descriptors
+ * O: The checksum of the reads
+ */
+long uarray2_cases(int size, long bytes, int reps, const int *fds)
+{
+    struct Target target;
+    int side = 1;
+    while ((long)(side + 1) * (side + 1) * size <= bytes) side++;
+    long cells = (long)side * side;
+
+    memset(&target, 0, sizeof(target));
+    target.uarray2 = UArray2_new(side, side, size);
+    positions(&target, side, side);
+
+    time_case("uarray2", size, bytes, "at_seq", at_seq, &target, cells,
+              reps, fds);
+    time_case("uarray2", size, bytes, "at_rand", at_rand, &target,
+              RANDOM_ACCESSES, reps, fds);
+    time_case("uarray2", size, bytes, "map_row_major", uarray2_map_row,
+              &target, cells, reps, fds);
+    time_case("uarray2", size, bytes, "map_col_major", uarray2_map_col,
+              &target, cells, reps, fds);
+
+    UArray2_free(&target.uarray2);
+    free(target.xs);
+    free(target.ys);
+    return target.sum;
+}
+
+/* Purpose: bit2_cases times every Bit2_T case on a square bit map that
+ *          takes up a given number of bytes
+ * I: The working set in bytes, the number of runs of each case, and the
+ *    counter descriptors
+ * O: The checksum of the reads
+ */
+long bit2_cases(long bytes, int reps, const int *fds)
+{
+    struct Target target;
+    int side = 64;
+    while ((long)(side + 64) * (side + 64) / 8 <= bytes) side += 64;
+    long cells = (long)side * side;
+
+    memset(&target, 0, sizeof(target));
+    target.bit2 = Bit2_new(side, side);
+    positions(&target, side, side);
+
+    time_case("bit2", 0, bytes, "get_seq", get_seq, &target, cells, reps,
+              fds);
+    time_case("bit2", 0, bytes, "get_rand", get_rand, &target,
+              RANDOM_ACCESSES, reps, fds);
+    time_case("bit2", 0, bytes, "put_seq", put_seq, &target, cells, reps,
+              fds);
+    time_case("bit2", 0, bytes, "put_rand", put_rand, &target,
+              RANDOM_ACCESSES, reps, fds);
+    time_case("bit2", 0, bytes, "map_row_major", bit2_map_row, &target,
+              cells, reps, fds);
+    time_case("bit2", 0, bytes, "map_col_major", bit2_map_col, &target,
+              cells, reps, fds);
+
+    Bit2_free(&target.bit2);
+    free(target.xs);
+    free(target.ys);
+    return target.sum;
+}
+
+/* Purpose: time_case runs one case reps times and prints the time per
+ *          access of the median and the 99th percentile (nearest rank)
+ *          batch, each the median over the runs, and the counters per
+ *          access over all of the runs. A run goes over the case as many
+ *          times as it takes to make RANDOM_ACCESSES accesses. One untimed
+ *          pass comes first so every timed run starts with the structure
+ *          already touched
+ * I: The structure's name, its element size (0 for bits), the working set
+ *    in bytes, the case's name, the function that runs it once, what it
+ *    runs on, the accesses in one run, the number of runs, and the counter
+ *    descriptors
+ * O: N/A
+ */
+void time_case(const char *structure, int size, long bytes, const char *name,
+               void run(struct Target *target), struct Target *target,
+               long accesses, int reps, const int *fds)
+{
+    double medians[MAX_REPS], p99s[MAX_REPS];
+    long long before[NCOUNTERS], after[NCOUNTERS], total[NCOUNTERS];
+    long passes = (RANDOM_ACCESSES + accesses - 1) / accesses, p, b;
+    long nbatches = passes * accesses / BATCH;
+    char set[32];
+    int r, k;
+
+    /* one stamp before the first batch and one after every batch */
+    target->stamps = (double *)malloc((nbatches + 1) * sizeof(double));
+    assert(target->stamps);
+    memset(total, 0, sizeof(total));
+    target->nstamps = 1;
+    target->left = BATCH;
+    run(target);
+    for (r = 0; r < reps; r++) {
+        double *times = target->stamps;
+        target->nstamps = 1;
+        target->left = BATCH;
+        counters_read(fds, before);
+        times[0] = now();
+        for (p = 0; p < passes; p++)
+            run(target);
+        counters_read(fds, after);
+        for (k = 0; k < NCOUNTERS; k++)
+            total[k] += after[k] - before[k];
+
+        /* each stamp becomes the time per access of the batch after it */
+        for (b = 0; b < nbatches; b++)
+            times[b] = (times[b + 1] - times[b]) * 1e9 / BATCH;
+        qsort(times, nbatches, sizeof(double), compare_doubles);
+        medians[r] = times[nbatches / 2];
+        p99s[r] = times[(99 * nbatches + 99) / 100 - 1];
+    }
+    free(target->stamps);
+    target->stamps = NULL;
+    qsort(medians, reps, sizeof(double), compare_doubles);
+    qsort(p99s, reps, sizeof(double), compare_doubles);
+
+    if (bytes >= 1 << 20) sprintf(set, "%ldM", bytes >> 20);
+    else sprintf(set, "%ldK", bytes >> 10);
+    printf("%-8s ", structure);
+    if (size > 0) printf("%4d", size);
+    else printf("%4s", "bit");
+    printf(" %8s %-14s %10.3f %10.3f", set, name, medians[reps / 2],
+           p99s[reps / 2]);
+    for (k = 0; k < NCOUNTERS; k++) {
+        if (fds[k] < 0) printf(" %8s", "-");
+        else printf(" %8.3f",
+                    (double)total[k] / reps / (passes * accesses));
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/* Purpose: counters_open opens a counter for each of enum counter on this
+ *          thread, counting user time only, which an unprivileged process
+ *          is allowed to do on most kernels
+ * I: An array of NCOUNTERS descriptors to fill in
+ * O: N/A (a descriptor is -1 where its counter could not be opened)
+ */
+void counters_open(int *fds)
+{
+    int k;
+    for (k = 0; k < NCOUNTERS; k++) fds[k] = -1;
+#ifdef __linux__
+    static const unsigned long long configs[NCOUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    struct perf_event_attr attr;
+    for (k = 0; k < NCOUNTERS; k++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[k];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fds[k] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+/* Purpose: counters_read reads the current value of every open counter
+ * I: The counter descriptors and an array of NCOUNTERS values to fill in
+ * O: N/A (a value is 0 where its counter is not open or cannot be read)
+ */
+void counters_read(const int *fds, long long *values)
+{
+    int k;
+    for (k = 0; k < NCOUNTERS; k++) {
+        values[k] = 0;
+#ifdef __linux__
+        if (fds[k] >= 0
+            && read(fds[k], &values[k], sizeof(values[k]))
+               != sizeof(values[k]))
+            values[k] = 0;
+#endif
+    }
+}
+
+/* Purpose: stamp records the time at the end of a batch of accesses
+ * I: A pointer to the target
+ * O: BATCH, the accesses until the next stamp
+ */
+int stamp(struct Target *target)
+{
+    target->stamps[target->nstamps++] = now();
+    return BATCH;
+}
+
+/* Purpose: compare_doubles orders doubles for qsort
+ * I: Pointers to two doubles
+ * O: A negative, zero, or positive int as the first is less than, equal
+ *    to, or greater than the second
+ */
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Purpose: positions picks the random positions the random cases visit,
+ *          the same ones on every run
+ * I: A pointer to the target and the width and height to pick within
+ * O: N/A
+ */
+void positions(struct Target *target, int width, int height)
+{
+    int k;
+    target->xs = (int *)malloc(RANDOM_ACCESSES * sizeof(int));
+    target->ys = (int *)malloc(RANDOM_ACCESSES * sizeof(int));
+    assert(target->xs && target->ys);
+    srand(40);
+    for (k = 0; k < RANDOM_ACCESSES; k++) {
+        target->xs[k] = rand() % width;
+        target->ys[k] = rand() % height;
+    }
+}
+
+/* Purpose: at_seq reads the first byte of every element with UArray2_at,
+ *          row by row
+ * I: A pointer to the target
+ * O: N/A
+ */
+void at_seq(struct Target *target)
+{
+    UArray2_T uarray2 = target->uarray2;
+    int width = UArray2_width(uarray2), height = UArray2_height(uarray2);
+    long sum = 0;
+    int i, j, left = target->left;
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++) {
+            sum += *(unsigned char *)UArray2_at(uarray2, i, j);
+            if (--left == 0) left = stamp(target);
+        }
+    target->sum += sum;
+    target->left = left;
+}
+
+/* Purpose: at_rand reads the first byte of the element at every random
+ *          position with UArray2_at
+ * I: A pointer to the target
+ * O: N/A
+ */
+void at_rand(struct Target *target)
+{
+    UArray2_T uarray2 = target->uarray2;
+    long sum = 0;
+    int k, left = target->left;
+    for (k = 0; k < RANDOM_ACCESSES; k++) {
+        sum += *(unsigned char *)UArray2_at(uarray2, target->xs[k],
+                                            target->ys[k]);
+        if (--left == 0) left = stamp(target);
+    }
+    target->sum += sum;
+    target->left = left;
+}
+
+/* Purpose: uarray2_map_row and uarray2_map_col read every element through
+ *          UArray2_map_row_major and UArray2_map_col_major
+ * I: A pointer to the target
+ * O: N/A
+ */
+void uarray2_map_row(struct Target *target)
+{
+    UArray2_map_row_major(target->uarray2, touch, target);
+}
+
+void uarray2_map_col(struct Target *target)
+{
+    UArray2_map_col_major(target->uarray2, touch, target);
+}
+
+/* Purpose: touch is the apply function for both UArray2 maps; it adds the
+ *          first byte of each element to the target's checksum and counts
+ *          down to its next stamp
+ * I: A position, the UArray2_T, a pointer to the element, and a pointer to
+ *    the target
+ * O: N/A
+ */
+void touch(int i, int j, UArray2_T uarray2, void *elem, void *cl)
+{
+    struct Target *target = cl;
+    (void) i;
+    (void) j;
+    (void) uarray2;
+    target->sum += *(unsigned char *)elem;
+    if (--target->left == 0) target->left = stamp(target);
+}
+
+/* Purpose: get_seq reads every bit with Bit2_get, row by row
+ * I: A pointer to the target
+ * O: N/A
+ */
+void get_seq(struct Target *target)
+{
+    Bit2_T bit2 = target->bit2;
+    int width = Bit2_width(bit2), height = Bit2_height(bit2);
+    long sum = 0;
+    int i, j, left = target->left;
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++) {
+            sum += Bit2_get(bit2, i, j);
+            if (--left == 0) left = stamp(target);
+        }
+    target->sum += sum;
+    target->left = left;
+}
+
+/* Purpose: get_rand reads the bit at every random position with Bit2_get
+ * I: A pointer to the target
+ * O: N/A
+ */
+void get_rand(struct Target *target)
+{
+    Bit2_T bit2 = target->bit2;
+    long sum = 0;
+    int k, left = target->left;
+    for (k = 0; k < RANDOM_ACCESSES; k++) {
+        sum += Bit2_get(bit2, target->xs[k], target->ys[k]);
+        if (--left == 0) left = stamp(target);
+    }
+    target->sum += sum;
+    target->left = left;
+}
+
+/* Purpose: put_seq writes every bit with Bit2_put, row by row, alternating
+ *          0 and 1 so that every write changes its word
+ * I: A pointer to the target
+ * O: N/A
+ */
+void put_seq(struct Target *target)
+{
+    Bit2_T bit2 = target->bit2;
+    int width = Bit2_width(bit2), height = Bit2_height(bit2);
+    long sum = 0;
+    int i, j, left = target->left;
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++) {
+            sum += Bit2_put(bit2, i, j, (i + j + (int)target->sum) & 1);
+            if (--left == 0) left = stamp(target);
+        }
+    target->sum += sum;
+    target->left = left;
+}
+
+/* Purpose: put_rand writes the bit at every random position with Bit2_put
+ * I: A pointer to the target
+ * O: N/A
+ */
+void put_rand(struct Target *target)
+{
+    Bit2_T bit2 = target->bit2;
+    long sum = 0;
+    int k, left = target->left;
+    for (k = 0; k < RANDOM_ACCESSES; k++) {
+        sum += Bit2_put(bit2, target->xs[k], target->ys[k], k & 1);
+        if (--left == 0) left = stamp(target);
+    }
+    target->sum += sum;
+    target->left = left;
+}
+
+/* Purpose: bit2_map_row and bit2_map_col read every bit through
+ *          Bit2_map_row_major and Bit2_map_col_major
+ * I: A pointer to the target
+ * O: N/A
+ */
+void bit2_map_row(struct Target *target)
+{
+    Bit2_map_row_major(target->bit2, touch_bit, target);
+}
+
+void bit2_map_col(struct Target *target)
+{
+    Bit2_map_col_major(target->bit2, touch_bit, target);
+}
+
+/* Purpose: touch_bit is the apply function for both Bit2 maps; it adds
+ *          each bit to the target's checksum and counts down to its next
+ *          stamp
+ * I: A position, the Bit2_T, the bit, and a pointer to the target
+ * O: N/A
+ */
+void touch_bit(int i, int j, Bit2_T bit2, int bit, void *cl)
+{
+    struct Target *target = cl;
+    (void) i;
+    (void) j;
+    (void) bit2;
+    target->sum += bit;
+    if (--target->left == 0) target->left = stamp(target);
+}
+
+/* Purpose: now returns the current time of a monotonic clock
+ * I: N/A
+ * O: The current time in seconds
+ */
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,118 @@
+#!/bin/sh
+#
+#       bench.sh
+#       by Lewis Bobrow and John Stewart
+#       February 10th 2020
+#       Assignment: HW2 (iii)
+#
+#       This script runs the benchmarks behind "make bench" and writes one
+#       CSV row per timing to stdout. It makes synthetic pages with pbmgen
+#       (noise at each density, a spiral, all black, and a checkerboard) at
+#       each size, runs unblackedges --stats on each with every fill, and
+#       reports the read, seed, fill, and write phases. It then times sudoku
+#       over a set of generated boards, and the UArray2 and Bit2 map orders
+#       from uarray2_bench and bit2_bench. Every row has the wall time, the
+#       pixels (or cells) per second, and the peak memory of the process.
+#
+#       Settings come from the environment:
+#           BENCH_SIZES      page sizes, "1000x1000 4000x3000" by default
+#           BENCH_DENSITIES  noise densities in percent, "10 50 90"
+#           BENCH_RUNS       runs of each unblackedges case, 3
+#           BENCH_BOARDS     sudoku boards, 200
+#           BENCH_MAP_SIZE   grid for the map order benchmarks, "4000 4000"
+#
+#       Usage: sh bench.sh > bench.csv
+
+sizes=${BENCH_SIZES:-"1000x1000 4000x3000"}
+densities=${BENCH_DENSITIES:-"10 50 90"}
+runs=${BENCH_RUNS:-3}
+boards=${BENCH_BOARDS:-200}
+map_size=${BENCH_MAP_SIZE:-"4000 4000"}
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT INT TERM
+
+echo "suite,case,workload,width,height,phase,run,wall_ms,cpu_ms,\
+pixels_per_sec,peak_rss_kb"
+
+# unblackedges: one --stats line per run, split into a row per phase (the
+# fills without a Stack have no seed phase, so no seed row)
+for size in $sizes; do
+    width=${size%x*}
+    height=${size#*x}
+    workloads="spiral black checker"
+    for density in $densities; do
+        workloads="$workloads noise$density"
+    done
+    for workload in $workloads; do
+        case $workload in
+            noise*) ./pbmgen --raw noise "$width" "$height" \
+                        "${workload#noise}" ;;
+            *)      ./pbmgen --raw "$workload" "$width" "$height" ;;
+        esac > "$dir/page.pbm" || exit 1
+        for fill in span words tiles; do
+            run=1
+            while [ "$run" -le "$runs" ]; do
+                ./unblackedges --stats --raw --fill=$fill "$dir/page.pbm" \
+                    2>&1 >/dev/null | awk -v fill=$fill -v workload=$workload \
+                    -v run=$run '
+                    /^\{/ {
+                        width = field($0, "width")
+                        height = field($0, "height")
+                        rss = field($0, "peak_rss_kb")
+                        split("read seed fill write", phases, " ")
+                        for (k = 1; k <= 4; k++) {
+                            p = phases[k]
+                            at = index($0, "\"" p "\": {")
+                            if (at == 0) continue   # null: not in this fill
+                            rest = substr($0, at)
+                            wall = field(rest, "wall_ms")
+                            cpu = field(rest, "cpu_ms")
+                            rate = wall > 0 ? width * height / (wall / 1e3) : 0
+                            printf "unblackedges,%s,%s,%d,%d,%s,%d,%s,%s," \
+                                   "%.0f,%s\n", fill, workload, width,
+                                   height, p, run, wall, cpu, rate, rss
+                        }
+                    }
+                    function field(s, name,    rest) {
+                        rest = substr(s, index(s, "\"" name "\": ") \
+                                      + length(name) + 4)
+                        return rest + 0
+                    }'
+                run=$((run + 1))
+            done
+        done
+    done
+done
+
+# sudoku: the time to check a set of boards, one process each
+k=1
+while [ "$k" -le "$boards" ]; do
+    ./pbmgen sudoku "$k" > "$dir/board$k.pgm" || exit 1
+    k=$((k + 1))
+done
+start=$(date +%s%N)
+k=1
+while [ "$k" -le "$boards" ]; do
+    ./sudoku "$dir/board$k.pgm" || echo "sudoku rejected board $k" >&2
+    k=$((k + 1))
+done
+end=$(date +%s%N)
+awk -v ns=$((end - start)) -v boards="$boards" 'BEGIN {
+    printf "sudoku,check,boards%d,9,9,all,1,%.3f,,%.0f,\n", boards,
+        ns / 1e6, boards * 81 / (ns / 1e9)
+}'
+
+# the map orders, from the benchmark programs' "name ms ns/elem" lines
+# (4-byte UArray2 elements, and one thread for the parallel maps)
+for bench in "uarray2_bench $map_size 4 1" "bit2_bench $map_size 1"; do
+    ./$bench | awk -v suite=${bench%%_*} -v size="$map_size" '
+        /^map_(row|col)_major / { name[++n] = $1; ms[n] = $2; ns[n] = $4 }
+        /^peak rss / { rss = $3 }
+        END {
+            split(size, dims, " ")
+            for (k = 1; k <= n; k++)
+                printf "%s,%s,grid,%d,%d,map,1,%s,,%.0f,%s\n", suite,
+                    name[k], dims[1], dims[2], ms[k], 1e9 / ns[k], rss
+        }'
+done
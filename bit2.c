@@ -8,13 +8,78 @@
  *      declared in bit2.h
  */
 
+#define _POSIX_C_SOURCE 200112L  /* for posix_memalign */
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #include "bit2.h"
+#include "bitvec.h"
+#include "pool.h"
+
+/* alignment of the word block; one cache line on the machines we use */
+#define BIT2_ALIGN 64
+
+/* the reorientations that move rows into columns and go through
+ * transpose8
+ */
+enum orient { TRANSPOSE, ROTATE90, ROTATE270 };
+
+/* the ways a rectangle of one Bit2_T can be combined into another */
+enum rect_op { RECT_AND, RECT_OR, RECT_XOR, RECT_NOT };
+
+/* words in one BIT2_ALIGN-byte cache line */
+#define LINE_WORDS (BIT2_ALIGN / (int)sizeof(uint64_t))
+
+/* struct passed to map_band through Pool_run, describing one parallel map */
+struct band_job {
+    Bit2_T bit2;
+    void (*apply)(int i, int j, Bit2_T bit2, int elem, void *cl);
+    void **cls;
+    int nbands;
+    int by_word;    /* 1 for read-only chunks of words instead of rows */
+};
+
+/* side of the square tiles of 8 x 8 blocks that reorient walks */
+#define BIT2_TILE 64
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+static uint64_t tail_mask(Bit2_T bit2);
+static inline int ctz64(uint64_t word);
+static void map_par(struct band_job *job,
+                    void reduce(void *cl, void *worker_cl));
+static void map_band(int k, void *cl);
+static long band_edge(struct band_job *job, int k);
+static void clear_padding(Bit2_T bit2);
+static void combine_rect(Bit2_T dst, int dx, int dy, Bit2_T src, int sx,
+                         int sy, int w, int h, enum rect_op op);
+static void gather(Bit2_T bit2, int j, long start, uint64_t *out, int n);
+static Bit2_T reorient(Bit2_T bit2, enum orient how);
+static void reorient_block(Bit2_T src, Bit2_T dst, int x, int y,
+                           enum orient how);
+static void reorient_bit(Bit2_T src, Bit2_T dst, int i, int j,
+                         enum orient how);
+static Bit2_T mirror(Bit2_T bit2, int flip_x, int flip_y);
+static void reverse_row(const uint64_t *src, uint64_t *dst, int nwords,
+                        int width);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose: Bit2_buffer_size returns how many bytes of storage a bit map of
+ *          the given size needs, padding included, for callers preparing a
+ *          buffer to wrap
+ * I: Two nonnegative integers representing the width and height
+ * O: The number of bytes
+ */
+long Bit2_buffer_size(int row, int col)
+{
+    assert(row >= 0 && col >= 0);
+    return (long)col * ((row + 63) / 64) * (long)sizeof(uint64_t);
+}
 
 /* Purpose: Bit2_new instantiates a Bit2_T object, allocates adequate
  *          memory for it, and initializes the struct variables using
- *          the parameters and the Hanson Bit_new function
+ *          the parameters. All bits start at 0
  * I: Two nonnegative integer values representing the width and
  *    height of the bit map.
  * O: A Bit2_T object
@@ -23,25 +88,105 @@ Bit2_T Bit2_new(int row, int col)
 {
     assert(row >= 0 && col >= 0);
 
-    Bit2_T bit2 = (Bit2_T) malloc(2 * sizeof(Bit2_T));
+    Bit2_T bit2 = (Bit2_T) malloc(sizeof(*bit2));
+    assert(bit2);
     bit2->width = row;
     bit2->height = col;
+    bit2->stride = (row + 63) / 64;
+    bit2->owner = BIT2_HEAP;
+
+    /* one block of col rows, each padded to a whole number of words */
+    long nbytes = Bit2_buffer_size(row, col);
+    void *words;
+    if (posix_memalign(&words, BIT2_ALIGN,
+                       nbytes > 0 ? nbytes : BIT2_ALIGN) != 0)
+        words = NULL;
+    assert(words);
+    memset(words, 0, nbytes);
+    bit2->words = words;
+
+    return bit2;
+}
 
-    /* single 1D array with row * col positions to represent a 2D array */
-    bit2->array = Bit_new(row * col);
+/* Purpose: Bit2_new_in is Bit2_new with the Bit2_T and its bits allocated
+ *          from an arena, so that many short-lived bit maps cost one
+ *          allocation each and can all be released at once with
+ *          Arena_free(arena). Bit2_free on such a map only clears the
+ *          caller's pointer
+ * I: An existing Arena_T, and the width and height as for Bit2_new
+ * O: A Bit2_T object that lives as long as the arena's current contents
+ */
+Bit2_T Bit2_new_in(Arena_T arena, int row, int col)
+{
+    assert(arena);
+    assert(row >= 0 && col >= 0);
+
+    /* the struct and the words share one arena allocation; the slack lets
+     * the words start on a cache line like Bit2_new's do
+     */
+    long nbytes = Bit2_buffer_size(row, col);
+    char *block = Arena_alloc(arena, sizeof(struct Bit2_T) + BIT2_ALIGN
+                              + nbytes, __FILE__, __LINE__);
+    Bit2_T bit2 = (Bit2_T) block;
+    uintptr_t words = (uintptr_t)(block + sizeof(struct Bit2_T));
+    words = (words + BIT2_ALIGN - 1) & ~(uintptr_t)(BIT2_ALIGN - 1);
+
+    bit2->width = row;
+    bit2->height = col;
+    bit2->stride = (row + 63) / 64;
+    bit2->owner = BIT2_ARENA;
+    bit2->words = (uint64_t *)words;
+    memset(bit2->words, 0, nbytes);
+
+    return bit2;
+}
+
+/* Purpose: Bit2_wrap makes a Bit2_T over a caller-owned buffer without
+ *          copying it. The buffer holds the bits in the layout described
+ *          above and keeps its contents. Bit2_free frees the Bit2_T but
+ *          never the buffer
+ * I: A nonnull buffer of at least Bit2_buffer_size(row, col) bytes, aligned
+ *    for a uint64_t, and the width and height
+ * O: A Bit2_T object whose bits are the buffer
+ */
+Bit2_T Bit2_wrap(void *bits, int row, int col)
+{
+    assert(bits);
+    assert((uintptr_t)bits % sizeof(uint64_t) == 0);
+    assert(row >= 0 && col >= 0);
+
+    Bit2_T bit2 = (Bit2_T) malloc(sizeof(*bit2));
+    assert(bit2);
+    bit2->width = row;
+    bit2->height = col;
+    bit2->stride = (row + 63) / 64;
+    bit2->owner = BIT2_WRAPPED;
+    bit2->words = bits;
 
     return bit2;
 }
 
-/* Purpose: Bit2_free frees memory allocated for the Bit2_T's array varaible
+/* Purpose: Bit2_free frees memory allocated for the Bit2_T and, if Bit2_new
+ *          allocated them, its bits
  * I: A nonnull pointer to a Bit2_T object
  * O: N/A
  */
 void Bit2_free(Bit2_T *bit2)
 {
     assert(bit2 && *bit2);
-    Bit_free(&((*bit2)->array));
-    free(*bit2);
+    switch ((*bit2)->owner) {
+    case BIT2_HEAP:
+        free((*bit2)->words);
+        free(*bit2);
+        break;
+    case BIT2_WRAPPED:
+        free(*bit2);
+        break;
+    case BIT2_ARENA:
+        /* released with the rest of the arena by Arena_free */
+        break;
+    }
+    *bit2 = NULL;
 }
 
 /* Purpose: Bit2_width returns the value for the width of a given Bit2_T
@@ -76,8 +221,8 @@ float Bit2_size(Bit2_T bit2)
 }
 
 /* Purpose: Bit2_get retrieves the value in the specified row and col
- *          position in the bit map by accessing the corresponding index
- *          in the 1D Bit Vector
+ *          position in the bit map by accessing the corresponding bit
+ *          of the word it is stored in
  * I: An existing and initialized Bit2_T object, and a [row, column] position
  *    within that object (defined by row and col respectively). These
  *    positions must be both nonnegative and less than the max width and
@@ -90,7 +235,8 @@ int Bit2_get(Bit2_T bit2, int row, int col)
     assert(bit2);
     assert(row < Bit2_width(bit2) && row >= 0);
     assert(col < Bit2_height(bit2) && col >= 0);
-    return Bit_get(bit2->array, (bit2->width * col) + row);
+    uint64_t word = bit2->words[(size_t)col * bit2->stride + row / 64];
+    return (word >> (row % 64)) & 1;
 }
 
 /* Purpose: Bit2_put places or replaces a certain integer value at position
@@ -107,12 +253,107 @@ int Bit2_put(Bit2_T bit2, int row, int col, int bit)
     assert(bit2);
     assert(row < Bit2_width(bit2) && row >= 0);
     assert(col < Bit2_height(bit2) && col >= 0);
-    return Bit_put(bit2->array, (bit2->width * col) + row, bit);
+    assert(bit == 0 || bit == 1);
+    uint64_t *word = &bit2->words[(size_t)col * bit2->stride + row / 64];
+    uint64_t mask = (uint64_t)1 << (row % 64);
+    int prev = (*word & mask) != 0;
+    if (bit == 1) *word |= mask;
+    else *word &= ~mask;
+    return prev;
+}
+
+/* Purpose: Bit2_words_per_row returns the number of 64-bit words each row
+ *          of a given Bit2_T is stored in
+ * I: An existing and initialized Bit2_T object
+ * O: (width + 63) / 64
+ */
+int Bit2_words_per_row(Bit2_T bit2)
+{
+    assert(bit2);
+    return bit2->stride;
+}
+
+/* Purpose: Bit2_get_word returns word k of row j, which holds bits
+ *          [64 * k, j] .. [64 * k + 63, j]; bit b of the word is
+ *          [64 * k + b, j]. Bits past the width read as 0
+ * I: An existing and initialized Bit2_T object, a word number k that is
+ *    nonnegative and less than Bit2_words_per_row, and a row number j that
+ *    is nonnegative and less than the height
+ * O: The 64 bits
+ */
+uint64_t Bit2_get_word(Bit2_T bit2, int k, int j)
+{
+    assert(bit2);
+    assert(k >= 0 && k < bit2->stride);
+    assert(j >= 0 && j < bit2->height);
+    return bit2->words[(size_t)j * bit2->stride + k];
+}
+
+/* Purpose: Bit2_put_word replaces word k of row j (laid out as for
+ *          Bit2_get_word) with a given word. Bits past the width are
+ *          dropped, so the padding stays 0
+ * I: An existing and initialized Bit2_T object, a word number and row
+ *    number as for Bit2_get_word, and the 64 bits to store
+ * O: The word that was there before
+ */
+uint64_t Bit2_put_word(Bit2_T bit2, int k, int j, uint64_t word)
+{
+    assert(bit2);
+    assert(k >= 0 && k < bit2->stride);
+    assert(j >= 0 && j < bit2->height);
+    uint64_t *p = &bit2->words[(size_t)j * bit2->stride + k];
+    uint64_t prev = *p;
+    if (k == bit2->stride - 1) word &= tail_mask(bit2);
+    *p = word;
+    return prev;
+}
+
+/* Purpose: Bit2_row_words returns a pointer to the words of row j, laid out
+ *          as for Bit2_get_word, so callers can run their own loop over a
+ *          row. Callers writing through it must leave the padding bits 0
+ * I: An existing and initialized Bit2_T object, a row number j that is
+ *    nonnegative and less than the height, and a pointer that receives the
+ *    number of words in the row (may be NULL)
+ * O: A pointer to word 0 of row j
+ */
+uint64_t *Bit2_row_words(Bit2_T bit2, int j, int *nwords)
+{
+    assert(bit2);
+    assert(j >= 0 && j < bit2->height);
+    if (nwords != NULL) *nwords = bit2->stride;
+    return bit2->words + (size_t)j * bit2->stride;
+}
+
+/* Purpose: Bit2_map_row_words applies a certain function to every row of a
+ *          given Bit2_T object, top to bottom, handing it the row's words
+ *          (laid out as for Bit2_get_word) so it can work on 64 bits at a
+ *          time. The apply function may change the words; any padding bits
+ *          it sets are cleared again after it returns
+ * I: An existing and initialized Bit2_T object, an apply function that takes
+ *    in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void Bit2_map_row_words(Bit2_T bit2,
+                        void apply(int j, Bit2_T bit2, uint64_t *words,
+                        int nwords, void *cl), void *cl)
+{
+    assert(bit2);
+    int j, stride = bit2->stride;
+    uint64_t mask = tail_mask(bit2);
+    uint64_t *row = bit2->words;
+    if (stride == 0) return;
+    for (j = 0; j < bit2->height; j++) {
+        apply(j, bit2, row, stride, cl);
+        row[stride - 1] &= mask;
+        row += stride;
+    }
 }
 
 /* Purpose: Bit2_map_row_major applies a certain function to all of the
  *          elements within a given Bit2_T object, iterating through the
- *          object one row at a time.
+ *          object one row at a time. Each word is loaded once and its bits
+ *          are handed out in order
  * I: An existing and initialized Bit2_T object, an apply function that takes
  *    in the parameters specified below, a void pointer to carry certain
  *    values over between function calls
@@ -125,13 +366,127 @@ void Bit2_map_row_major(Bit2_T bit2,
     assert(bit2);
     int i, j;       // [i, j] represents [row position, col position]
     for (j = 0; j < bit2->height; j++) {
+        const uint64_t *row = bit2->words + (size_t)j * bit2->stride;
         for (i = 0; i < bit2->width; i++) {
-            /* col position is getting bigger faster */
-            apply(i, j, bit2, Bit2_get(bit2, i, j), cl);
+            /* col position is getting bigger faster; reading the word
+             * again each time lets apply change bits it has not seen yet
+             */
+            apply(i, j, bit2, (row[i / 64] >> (i % 64)) & 1, cl);
         }
     }
 }
 
+/* Purpose: Bit2_map_row_major_par applies a certain function to all of the
+ *          bits of a given Bit2_T object on nthreads threads from the shared
+ *          Pool_T. The rows are split into nthreads bands of consecutive
+ *          rows and band k is visited in row-major order with cls[k] as its
+ *          closure. Band edges are moved down to rows that start on a
+ *          64-byte boundary of the word block (which Bit2_new and
+ *          Bit2_new_in align to a cache line), so no two bands ever write
+ *          the same word or cache line. Once every band is done, reduce (if
+ *          not NULL) is called as reduce(cls[0], cls[k]) for k = 1 ..
+ *          nthreads - 1 in that order. apply may only change the bit it is
+ *          given, with Bit2_put
+ * I: An existing and initialized Bit2_T object, an apply function that takes
+ *    in the parameters specified below, an array of nthreads closures (or
+ *    NULL, in which case every worker gets NULL), a positive number of
+ *    threads, and a reduce function (or NULL)
+ * O: N/A
+ */
+void Bit2_map_row_major_par(Bit2_T bit2,
+                            void apply(int row, int col, Bit2_T bit2,
+                            int elem, void *cl), void *cls[], int nthreads,
+                            void reduce(void *cl, void *worker_cl))
+{
+    assert(bit2 && apply);
+    assert(nthreads > 0);
+    struct band_job job = { bit2, apply, cls, nthreads, 0 };
+    map_par(&job, reduce);
+}
+
+/* Purpose: Bit2_map_row_major_const_par is Bit2_map_row_major_par for apply
+ *          functions that only read the bit map. Since nothing is written,
+ *          the words are split evenly into nthreads chunks of whole cache
+ *          lines instead of whole rows, so a map with few, very long rows
+ *          still uses every thread. Chunk k is visited in row-major order
+ *          with cls[k] as its closure, and the results are merged with
+ *          reduce as for Bit2_map_row_major_par
+ * I: An existing and initialized Bit2_T object, an apply function that takes
+ *    in the parameters specified below and does not change the Bit2_T, an
+ *    array of nthreads closures (or NULL), a positive number of threads,
+ *    and a reduce function (or NULL)
+ * O: N/A
+ */
+void Bit2_map_row_major_const_par(Bit2_T bit2,
+                                  void apply(int row, int col, Bit2_T bit2,
+                                  int elem, void *cl), void *cls[],
+                                  int nthreads,
+                                  void reduce(void *cl, void *worker_cl))
+{
+    assert(bit2 && apply);
+    assert(nthreads > 0);
+    struct band_job job = { bit2, apply, cls, nthreads, 1 };
+    map_par(&job, reduce);
+}
+
+/* Purpose: Bit2_map_runs calls a certain function once for every maximal
+ *          run of 1 bits in a given Bit2_T object, row by row from the top
+ *          and left to right within a row. Runs are found a word at a time
+ *          by counting trailing zeros, so a pass costs time in proportion
+ *          to the number of runs, not the number of pixels. A run never
+ *          continues from one row to the next
+ * I: An existing and initialized Bit2_T object, an apply function that takes
+ *    the position [i, j] of the first bit of a run and the run's length
+ *    (at least 1), the Bit2_T, and the closure; and a void pointer to carry
+ *    certain values over between function calls. Each word is read when
+ *    the scan reaches it, so apply may change bits it has already been
+ *    handed
+ * O: N/A
+ */
+void Bit2_map_runs(Bit2_T bit2,
+                   void apply(int i, int j, int len, Bit2_T bit2, void *cl),
+                   void *cl)
+{
+    assert(bit2);
+    int j, k;
+    for (j = 0; j < bit2->height; j++) {
+        const uint64_t *row = bit2->words + (size_t)j * bit2->stride;
+        int start = -1;         /* first bit of the open run, if any */
+        for (k = 0; k < bit2->stride; k++) {
+            uint64_t word = row[k];
+            int base = 64 * k;
+
+            /* a run left open by the last word ends at this word's first
+             * 0 bit, or takes in the whole word
+             */
+            if (start >= 0) {
+                if (word == ~(uint64_t)0) continue;
+                int end = ctz64(~word);
+                apply(start, j, base + end - start, bit2, cl);
+                start = -1;
+                word &= ~(uint64_t)0 << end;
+            }
+
+            /* every other run starts and, unless it reaches the top bit,
+             * ends inside this word
+             */
+            while (word != 0) {
+                int first = ctz64(word);
+                uint64_t zeros = ~word & (~(uint64_t)0 << first);
+                if (zeros == 0) {
+                    start = base + first;
+                    break;
+                }
+                int end = ctz64(zeros);
+                apply(base + first, j, end - first, bit2, cl);
+                word &= ~(uint64_t)0 << end;
+            }
+        }
+        /* the padding is 0, so an open run here reaches the last column */
+        if (start >= 0) apply(start, j, bit2->width - start, bit2, cl);
+    }
+}
+
 /* Purpose: Bit2_map_col_major applies a certain function to all of the
  *          elements within a given Bit2_T object, iterating through the
  *          object one column at a time.
@@ -153,3 +508,667 @@ void Bit2_map_col_major(Bit2_T bit2,
         }
     }
 }
+
+/* Purpose: Bit2_and, Bit2_or, and Bit2_xor set every bit of dst to the
+ *          and, or, or exclusive or of the same bit of a and b. They work
+ *          on whole rows of words with the vector kernels in bitvec.c
+ * I: Three existing and initialized Bit2_T objects of the same width and
+ *    height; dst may be a or b
+ * O: N/A
+ */
+void Bit2_and(Bit2_T dst, Bit2_T a, Bit2_T b)
+{
+    assert(dst && a && b);
+    assert(a->width == dst->width && a->height == dst->height);
+    assert(b->width == dst->width && b->height == dst->height);
+    Bitvec_and(dst->words, a->words, b->words,
+               (long)dst->height * dst->stride);
+}
+
+void Bit2_or(Bit2_T dst, Bit2_T a, Bit2_T b)
+{
+    assert(dst && a && b);
+    assert(a->width == dst->width && a->height == dst->height);
+    assert(b->width == dst->width && b->height == dst->height);
+    Bitvec_or(dst->words, a->words, b->words,
+              (long)dst->height * dst->stride);
+}
+
+void Bit2_xor(Bit2_T dst, Bit2_T a, Bit2_T b)
+{
+    assert(dst && a && b);
+    assert(a->width == dst->width && a->height == dst->height);
+    assert(b->width == dst->width && b->height == dst->height);
+    Bitvec_xor(dst->words, a->words, b->words,
+               (long)dst->height * dst->stride);
+}
+
+/* Purpose: Bit2_not sets every bit of dst to the complement of the same bit
+ *          of src
+ * I: Two existing and initialized Bit2_T objects of the same width and
+ *    height; dst may be src
+ * O: N/A
+ */
+void Bit2_not(Bit2_T dst, Bit2_T src)
+{
+    assert(dst && src);
+    assert(src->width == dst->width && src->height == dst->height);
+    Bitvec_not(dst->words, src->words, (long)dst->height * dst->stride);
+    clear_padding(dst);
+}
+
+/* Purpose: Bit2_count counts the bits of a Bit2_T that are 1
+ * I: An existing and initialized Bit2_T object
+ * O: The number of 1 bits
+ */
+long Bit2_count(Bit2_T bit2)
+{
+    assert(bit2);
+    /* the padding is always 0, so it can be counted along with the rows */
+    return Bitvec_count(bit2->words, (long)bit2->height * bit2->stride);
+}
+
+/* Purpose: Bit2_equal compares two Bit2_T objects, stopping at the first
+ *          word that differs
+ * I: Two existing and initialized Bit2_T objects
+ * O: 1 if they have the same width, height, and bits, 0 otherwise
+ */
+int Bit2_equal(Bit2_T a, Bit2_T b)
+{
+    assert(a && b);
+    if (a->width != b->width || a->height != b->height) return 0;
+    return Bitvec_equal(a->words, b->words, (long)a->height * a->stride);
+}
+
+/* Purpose: Bit2_and_rect, Bit2_or_rect, and Bit2_xor_rect combine the
+ *          w x h rectangle of src whose top left bit is [sx, sy] into the
+ *          one of dst whose top left bit is [dx, dy]: bit [dx + i, dy + j]
+ *          of dst becomes itself and, or, or exclusive or bit
+ *          [sx + i, sy + j] of src. Bits of dst outside the rectangle are
+ *          left alone. The rectangles need not start on the same bit of a
+ *          word; each source row is shifted into line with the destination
+ *          and then combined a vector at a time
+ * I: An existing and initialized destination Bit2_T and the position of
+ *    its rectangle, an existing and initialized source Bit2_T (may be dst,
+ *    and the rectangles may overlap) and the position of its rectangle, and
+ *    the nonnegative width and height of the rectangles, which must lie
+ *    inside both maps
+ * O: N/A
+ */
+void Bit2_and_rect(Bit2_T dst, int dx, int dy, Bit2_T src, int sx, int sy,
+                   int w, int h)
+{
+    combine_rect(dst, dx, dy, src, sx, sy, w, h, RECT_AND);
+}
+
+void Bit2_or_rect(Bit2_T dst, int dx, int dy, Bit2_T src, int sx, int sy,
+                  int w, int h)
+{
+    combine_rect(dst, dx, dy, src, sx, sy, w, h, RECT_OR);
+}
+
+void Bit2_xor_rect(Bit2_T dst, int dx, int dy, Bit2_T src, int sx, int sy,
+                   int w, int h)
+{
+    combine_rect(dst, dx, dy, src, sx, sy, w, h, RECT_XOR);
+}
+
+/* Purpose: Bit2_not_rect sets the w x h rectangle of dst whose top left bit
+ *          is [dx, dy] to the complement of the one of src whose top left
+ *          bit is [sx, sy]
+ * I: As for Bit2_and_rect
+ * O: N/A
+ */
+void Bit2_not_rect(Bit2_T dst, int dx, int dy, Bit2_T src, int sx, int sy,
+                   int w, int h)
+{
+    combine_rect(dst, dx, dy, src, sx, sy, w, h, RECT_NOT);
+}
+
+/* Purpose: Bit2_count_rect counts the 1 bits in the w x h rectangle of a
+ *          Bit2_T whose top left bit is [x, y]
+ * I: An existing and initialized Bit2_T object, and the position and
+ *    nonnegative size of a rectangle inside it
+ * O: The number of 1 bits
+ */
+long Bit2_count_rect(Bit2_T bit2, int x, int y, int w, int h)
+{
+    assert(bit2);
+    assert(x >= 0 && y >= 0 && w >= 0 && h >= 0);
+    assert(x + w <= bit2->width && y + h <= bit2->height);
+    if (w == 0 || h == 0) return 0;
+
+    int k0 = x / 64, n = (x + w - 1) / 64 - k0 + 1;
+    uint64_t first = ~(uint64_t)0 << (x % 64);
+    uint64_t last = (x + w) % 64 == 0 ? ~(uint64_t)0
+                    : ((uint64_t)1 << ((x + w) % 64)) - 1;
+    long total = 0;
+    int j;
+
+    /* the inner words count with the vector kernel; only the two edge
+     * words need masking
+     */
+    for (j = y; j < y + h; j++) {
+        const uint64_t *row = bit2->words + (size_t)j * bit2->stride + k0;
+        uint64_t edges[2];
+        if (n == 1) {
+            edges[0] = row[0] & first & last;
+            total += Bitvec_count(edges, 1);
+            continue;
+        }
+        edges[0] = row[0] & first;
+        edges[1] = row[n - 1] & last;
+        total += Bitvec_count(edges, 2) + Bitvec_count(row + 1, n - 2);
+    }
+    return total;
+}
+
+/* Purpose: Bit2_equal_rect compares the w x h rectangle of a whose top left
+ *          bit is [ax, ay] with the one of b whose top left bit is [bx, by]
+ * I: Two existing and initialized Bit2_T objects, the positions of the
+ *    rectangles, and their nonnegative width and height, which must lie
+ *    inside both maps
+ * O: 1 if every bit of the rectangles is the same, 0 otherwise
+ */
+int Bit2_equal_rect(Bit2_T a, int ax, int ay, Bit2_T b, int bx, int by,
+                    int w, int h)
+{
+    assert(a && b);
+    assert(ax >= 0 && ay >= 0 && bx >= 0 && by >= 0 && w >= 0 && h >= 0);
+    assert(ax + w <= a->width && ay + h <= a->height);
+    assert(bx + w <= b->width && by + h <= b->height);
+    if (w == 0 || h == 0) return 1;
+
+    /* both rows are shifted to start at bit 0 of a scratch row, with the
+     * bits past w cleared, then compared a vector at a time
+     */
+    int n = (w + 63) / 64, same = 1, j;
+    uint64_t last = w % 64 == 0 ? ~(uint64_t)0
+                    : ((uint64_t)1 << (w % 64)) - 1;
+    uint64_t *rows = malloc(2 * n * sizeof(uint64_t));
+    assert(rows);
+    for (j = 0; j < h && same; j++) {
+        gather(a, ay + j, ax, rows, n);
+        gather(b, by + j, bx, rows + n, n);
+        rows[n - 1] &= last;
+        rows[2 * n - 1] &= last;
+        same = Bitvec_equal(rows, rows + n, n);
+    }
+    free(rows);
+    return same;
+}
+
+/* Purpose: Bit2_transpose returns a new Bit2_T holding the transpose of a
+ *          given one: bit [i, j] of the source is bit [j, i] of the result.
+ *          The bits are moved 64 at a time by transposing 8 x 8 bit
+ *          matrices, and those are visited in 64 x 64 tiles so the rows of
+ *          both bit maps being touched stay in cache
+ * I: An existing and initialized Bit2_T object
+ * O: A new height x width Bit2_T, freed with Bit2_free
+ */
+Bit2_T Bit2_transpose(Bit2_T bit2)
+{
+    return reorient(bit2, TRANSPOSE);
+}
+
+/* Purpose: Bit2_rotate90 returns a new Bit2_T holding a given one rotated
+ *          90 degrees clockwise, so bit [i, j] of the source is bit
+ *          [height - 1 - j, i] of the result. It uses the same tiled 8 x 8
+ *          kernel as Bit2_transpose
+ * I: An existing and initialized Bit2_T object
+ * O: A new height x width Bit2_T, freed with Bit2_free
+ */
+Bit2_T Bit2_rotate90(Bit2_T bit2)
+{
+    return reorient(bit2, ROTATE90);
+}
+
+/* Purpose: Bit2_rotate180 returns a new Bit2_T holding a given one rotated
+ *          180 degrees, so bit [i, j] of the source is bit
+ *          [width - 1 - i, height - 1 - j] of the result
+ * I: An existing and initialized Bit2_T object
+ * O: A new width x height Bit2_T, freed with Bit2_free
+ */
+Bit2_T Bit2_rotate180(Bit2_T bit2)
+{
+    return mirror(bit2, 1, 1);
+}
+
+/* Purpose: Bit2_rotate270 returns a new Bit2_T holding a given one rotated
+ *          270 degrees clockwise, so bit [i, j] of the source is bit
+ *          [j, width - 1 - i] of the result. It uses the same tiled 8 x 8
+ *          kernel as Bit2_transpose
+ * I: An existing and initialized Bit2_T object
+ * O: A new height x width Bit2_T, freed with Bit2_free
+ */
+Bit2_T Bit2_rotate270(Bit2_T bit2)
+{
+    return reorient(bit2, ROTATE270);
+}
+
+/* Purpose: Bit2_flip_horizontal returns a new Bit2_T holding a given one
+ *          mirrored left to right, so bit [i, j] of the source is bit
+ *          [width - 1 - i, j] of the result
+ * I: An existing and initialized Bit2_T object
+ * O: A new width x height Bit2_T, freed with Bit2_free
+ */
+Bit2_T Bit2_flip_horizontal(Bit2_T bit2)
+{
+    return mirror(bit2, 1, 0);
+}
+
+/* Purpose: Bit2_flip_vertical returns a new Bit2_T holding a given one
+ *          mirrored top to bottom, so bit [i, j] of the source is bit
+ *          [i, height - 1 - j] of the result
+ * I: An existing and initialized Bit2_T object
+ * O: A new width x height Bit2_T, freed with Bit2_free
+ */
+Bit2_T Bit2_flip_vertical(Bit2_T bit2)
+{
+    return mirror(bit2, 0, 1);
+}
+
+/* Purpose: tail_mask returns the mask of the bits of the last word of a row
+ *          that are inside the width
+ * I: An existing and initialized Bit2_T object
+ * O: The mask (all ones when the width is a multiple of 64)
+ */
+static uint64_t tail_mask(Bit2_T bit2)
+{
+    int used = bit2->width % 64;
+    return used == 0 ? ~(uint64_t)0 : ((uint64_t)1 << used) - 1;
+}
+
+/* Purpose: ctz64 counts the 0 bits below the lowest 1 bit of a word
+ * I: A nonzero word
+ * O: The index of its lowest 1 bit
+ */
+static inline int ctz64(uint64_t word)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int n = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* Purpose: map_par runs every band of a parallel map on the shared pool and
+ *          then merges the workers' closures in band order
+ * I: A filled in band_job and a reduce function (or NULL)
+ * O: N/A
+ */
+static void map_par(struct band_job *job,
+                    void reduce(void *cl, void *worker_cl))
+{
+    int k;
+    Pool_run(Pool_shared(job->nbands), job->nbands, map_band, job);
+    if (reduce != NULL && job->cls != NULL)
+        for (k = 1; k < job->nbands; k++)
+            reduce(job->cls[0], job->cls[k]);
+}
+
+/* Purpose: band_edge returns where band k of a parallel map starts: a row
+ *          number for row bands, a word number for read-only word chunks.
+ *          The even split k * n / nbands is rounded up to the next row or
+ *          word that starts a cache line, so bands never share one
+ * I: A filled in band_job and a band number from 0 to nbands
+ * O: The first row or word of band k (the end of the map when k == nbands)
+ */
+static long band_edge(struct band_job *job, int k)
+{
+    Bit2_T bit2 = job->bit2;
+    long n = job->by_word ? (long)bit2->height * bit2->stride : bit2->height;
+    long step = LINE_WORDS, edge;
+
+    /* rows start on a line every step rows, the smallest step for which
+     * step * stride is a multiple of LINE_WORDS
+     */
+    if (!job->by_word)
+        for (step = 1; (step * bit2->stride) % LINE_WORDS != 0; step *= 2)
+            ;
+    edge = (long)k * n / job->nbands;
+    edge = (edge + step - 1) / step * step;
+    return edge < n ? edge : n;
+}
+
+/* Purpose: map_band is the pool task for one band of a parallel map. Row
+ *          bands visit their rows in row-major order; word chunks visit the
+ *          bits of their words in the same order, skipping the padding
+ * I: The band number and a void pointer to the band_job
+ * O: N/A
+ */
+static void map_band(int k, void *cl)
+{
+    struct band_job *job = cl;
+    Bit2_T bit2 = job->bit2;
+    void *worker_cl = job->cls != NULL ? job->cls[k] : NULL;
+    int stride = bit2->stride, width = bit2->width;
+    long first = band_edge(job, k), last = band_edge(job, k + 1), w;
+    int b;
+
+    /* a row band is the run of words from its first row to its last */
+    if (!job->by_word) {
+        first *= stride;
+        last *= stride;
+    }
+    for (w = first; w < last; w++) {
+        int j = w / stride, i = (w % stride) * 64;
+        int nbits = width - i < 64 ? width - i : 64;
+        for (b = 0; b < nbits; b++) {
+            /* reloaded every time, as in Bit2_map_row_major */
+            job->apply(i + b, j, bit2, (bit2->words[w] >> b) & 1,
+                       worker_cl);
+        }
+    }
+}
+
+/* Purpose: clear_padding clears the bits past the width in the last word
+ *          of every row, after an operation that may have set them
+ * I: An existing and initialized Bit2_T object
+ * O: N/A
+ */
+static void clear_padding(Bit2_T bit2)
+{
+    uint64_t mask = tail_mask(bit2);
+    int j;
+    if (mask == ~(uint64_t)0) return;
+    for (j = 0; j < bit2->height; j++)
+        bit2->words[(size_t)j * bit2->stride + bit2->stride - 1] &= mask;
+}
+
+/* Purpose: gather copies n words' worth of row j of a Bit2_T, starting at
+ *          bit start, into out, so that bit b of out[t] is bit
+ *          start + 64 * t + b of the row. Bits before the row (start may be
+ *          negative, down to -63) or past its last word read as 0
+ * I: An existing and initialized Bit2_T object, a row number, the first bit
+ *    to copy, a buffer of n words, and n
+ * O: N/A
+ */
+static void gather(Bit2_T bit2, int j, long start, uint64_t *out, int n)
+{
+    const uint64_t *row = bit2->words + (size_t)j * bit2->stride;
+    int nwords = bit2->stride, t;
+    for (t = 0; t < n; t++) {
+        long p = start + 64L * t;
+        if (p < 0) {
+            out[t] = nwords > 0 ? row[0] << -p : 0;
+            continue;
+        }
+        long k = p / 64;
+        int shift = p % 64;
+        uint64_t word = k < nwords ? row[k] >> shift : 0;
+        if (shift != 0 && k + 1 < nwords) word |= row[k + 1] << (64 - shift);
+        out[t] = word;
+    }
+}
+
+/* Purpose: combine_rect does the work of the Bit2_*_rect functions. For
+ *          each row, the source bits are gathered into a scratch row lined
+ *          up with the destination's words, the words covering the
+ *          rectangle are combined by a bitvec kernel, and the bits of the
+ *          two edge words that lie outside the rectangle are put back.
+ *          When src is dst and the source lies above the destination, the
+ *          rows go bottom up so no source row is changed before it is read
+ * I: As for Bit2_and_rect, and the operation
+ * O: N/A
+ */
+static void combine_rect(Bit2_T dst, int dx, int dy, Bit2_T src, int sx,
+                         int sy, int w, int h, enum rect_op op)
+{
+    assert(dst && src);
+    assert(dx >= 0 && dy >= 0 && sx >= 0 && sy >= 0 && w >= 0 && h >= 0);
+    assert(dx + w <= dst->width && dy + h <= dst->height);
+    assert(sx + w <= src->width && sy + h <= src->height);
+    if (w == 0 || h == 0) return;
+
+    int k0 = dx / 64, n = (dx + w - 1) / 64 - k0 + 1;
+    uint64_t first = ~(uint64_t)0 << (dx % 64);
+    uint64_t last = (dx + w) % 64 == 0 ? ~(uint64_t)0
+                    : ((uint64_t)1 << ((dx + w) % 64)) - 1;
+    int up = src == dst && sy < dy;
+    uint64_t *line = malloc(n * sizeof(uint64_t));
+    int r;
+    assert(line);
+    if (n == 1) first &= last;
+
+    for (r = 0; r < h; r++) {
+        int j = up ? h - 1 - r : r;
+        uint64_t *row = dst->words + (size_t)(dy + j) * dst->stride + k0;
+        uint64_t head = row[0], tail = row[n - 1];
+
+        gather(src, sy + j, sx - dx % 64, line, n);
+        switch (op) {
+        case RECT_AND: Bitvec_and(row, row, line, n); break;
+        case RECT_OR:  Bitvec_or(row, row, line, n); break;
+        case RECT_XOR: Bitvec_xor(row, row, line, n); break;
+        case RECT_NOT: Bitvec_not(row, line, n); break;
+        }
+
+        /* put back the bits of the edge words outside the rectangle */
+        if (n > 1) row[n - 1] = (row[n - 1] & last) | (tail & ~last);
+        row[0] = (row[0] & first) | (head & ~first);
+    }
+    free(line);
+}
+
+/* Purpose: get8 returns the 8 bits [x, y] .. [x + 7, y] as a byte, bit k
+ *          holding [x + k, y]. They may straddle two words of the row
+ * I: An existing and initialized Bit2_T object and a position with
+ *    x + 8 <= width
+ * O: The 8 bits
+ */
+static inline unsigned get8(Bit2_T bit2, int x, int y)
+{
+    const uint64_t *row = bit2->words + (size_t)y * bit2->stride;
+    int k = x / 64, off = x % 64;
+    uint64_t bits = row[k] >> off;
+    if (off > 56) bits |= row[k + 1] << (64 - off);
+    return bits & 0xff;
+}
+
+/* Purpose: put8 stores a byte into bits [x, y] .. [x + 7, y], bit k going
+ *          to [x + k, y]
+ * I: An existing and initialized Bit2_T object, a position with
+ *    x + 8 <= width, and the 8 bits
+ * O: N/A
+ */
+static inline void put8(Bit2_T bit2, int x, int y, unsigned byte)
+{
+    uint64_t *row = bit2->words + (size_t)y * bit2->stride;
+    int k = x / 64, off = x % 64;
+    row[k] = (row[k] & ~((uint64_t)0xff << off)) | ((uint64_t)byte << off);
+    if (off > 56) {
+        int spill = 64 - off;
+        row[k + 1] = (row[k + 1] & ~((uint64_t)0xff >> spill))
+                     | (byte >> spill);
+    }
+}
+
+/* Purpose: reverse8 reverses the order of the bits in a byte
+ * I: A byte
+ * O: The byte with bit k moved to bit 7 - k
+ */
+static inline unsigned reverse8(unsigned byte)
+{
+    byte = ((byte & 0xf0) >> 4) | ((byte & 0x0f) << 4);
+    byte = ((byte & 0xcc) >> 2) | ((byte & 0x33) << 2);
+    byte = ((byte & 0xaa) >> 1) | ((byte & 0x55) << 1);
+    return byte;
+}
+
+/* Purpose: reverse64 reverses the order of the bits in a word
+ * I: A word
+ * O: The word with bit k moved to bit 63 - k
+ */
+static inline uint64_t reverse64(uint64_t word)
+{
+    word = ((word >> 1) & 0x5555555555555555ULL)
+           | ((word & 0x5555555555555555ULL) << 1);
+    word = ((word >> 2) & 0x3333333333333333ULL)
+           | ((word & 0x3333333333333333ULL) << 2);
+    word = ((word >> 4) & 0x0f0f0f0f0f0f0f0fULL)
+           | ((word & 0x0f0f0f0f0f0f0f0fULL) << 4);
+#ifdef __GNUC__
+    return __builtin_bswap64(word);
+#else
+    word = ((word >> 8) & 0x00ff00ff00ff00ffULL)
+           | ((word & 0x00ff00ff00ff00ffULL) << 8);
+    word = ((word >> 16) & 0x0000ffff0000ffffULL)
+           | ((word & 0x0000ffff0000ffffULL) << 16);
+    return (word >> 32) | (word << 32);
+#endif
+}
+
+/* Purpose: transpose8 transposes an 8 x 8 bit matrix held in a 64-bit word
+ *          (bit 8 * r + c is row r, column c) with three rounds of swaps of
+ *          1 x 1, 2 x 2, and 4 x 4 sub-blocks
+ * I: The matrix
+ * O: The transposed matrix
+ */
+static inline uint64_t transpose8(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+/* Purpose: reorient makes the destination of a transpose or a 90/270 degree
+ *          rotation and fills it. Whole 8 x 8 blocks go through transpose8,
+ *          visited in BIT2_TILE x BIT2_TILE tiles; the bits in the right and
+ *          bottom strips that do not fill a block are moved one at a time
+ * I: An existing and initialized Bit2_T object and the reorientation
+ * O: A new height x width Bit2_T
+ */
+static Bit2_T reorient(Bit2_T bit2, enum orient how)
+{
+    assert(bit2);
+    int width = bit2->width, height = bit2->height;
+    int full_w = width & ~7, full_h = height & ~7;
+    Bit2_T dst = Bit2_new(height, width);
+    int tx, ty, x, y, i, j;
+
+    for (ty = 0; ty < full_h; ty += BIT2_TILE) {
+        for (tx = 0; tx < full_w; tx += BIT2_TILE) {
+            int y_end = ty + BIT2_TILE < full_h ? ty + BIT2_TILE : full_h;
+            int x_end = tx + BIT2_TILE < full_w ? tx + BIT2_TILE : full_w;
+            for (y = ty; y < y_end; y += 8)
+                for (x = tx; x < x_end; x += 8)
+                    reorient_block(bit2, dst, x, y, how);
+        }
+    }
+
+    /* right strip (every row), then the bottom strip under the blocks */
+    for (j = 0; j < height; j++)
+        for (i = full_w; i < width; i++)
+            reorient_bit(bit2, dst, i, j, how);
+    for (j = full_h; j < height; j++)
+        for (i = 0; i < full_w; i++)
+            reorient_bit(bit2, dst, i, j, how);
+
+    return dst;
+}
+
+/* Purpose: reorient_block moves the 8 x 8 block of bits whose top left bit
+ *          is [x, y] into its place in the destination
+ * I: The source and destination Bit2_T objects, the block position (both
+ *    multiples of 8, block inside the source), and the reorientation
+ * O: N/A
+ */
+static void reorient_block(Bit2_T src, Bit2_T dst, int x, int y,
+                           enum orient how)
+{
+    uint64_t block = 0;
+    int k;
+    for (k = 0; k < 8; k++)
+        block |= (uint64_t)get8(src, x, y + k) << (8 * k);
+
+    /* after the transpose, byte k holds source column x + k, bit r of it
+     * being source row y + r
+     */
+    block = transpose8(block);
+    for (k = 0; k < 8; k++) {
+        unsigned byte = (block >> (8 * k)) & 0xff;
+        if (how == TRANSPOSE)
+            put8(dst, y, x + k, byte);
+        else if (how == ROTATE90)
+            put8(dst, src->height - 8 - y, x + k, reverse8(byte));
+        else
+            put8(dst, y, src->width - 1 - (x + k), byte);
+    }
+}
+
+/* Purpose: reorient_bit moves a single bit to its place in the destination
+ * I: The source and destination Bit2_T objects, a position in the source,
+ *    and the reorientation
+ * O: N/A
+ */
+static void reorient_bit(Bit2_T src, Bit2_T dst, int i, int j,
+                         enum orient how)
+{
+    int bit = Bit2_get(src, i, j);
+    switch (how) {
+    case TRANSPOSE: Bit2_put(dst, j, i, bit); break;
+    case ROTATE90:  Bit2_put(dst, src->height - 1 - j, i, bit); break;
+    case ROTATE270: Bit2_put(dst, j, src->width - 1 - i, bit); break;
+    }
+}
+
+/* Purpose: mirror makes a copy of a Bit2_T flipped left to right, top to
+ *          bottom, or both (a 180 degree rotation). Rows stay rows, so a
+ *          row is either copied or reversed a word at a time
+ * I: An existing and initialized Bit2_T object, and whether to flip it
+ *    left to right and whether to flip it top to bottom
+ * O: A new width x height Bit2_T
+ */
+static Bit2_T mirror(Bit2_T bit2, int flip_x, int flip_y)
+{
+    assert(bit2);
+    int width = bit2->width, height = bit2->height;
+    int stride = bit2->stride;
+    Bit2_T dst = Bit2_new(width, height);
+    int j;
+
+    for (j = 0; j < height; j++) {
+        const uint64_t *from = bit2->words + (size_t)j * stride;
+        uint64_t *to = dst->words
+                       + (size_t)(flip_y ? height - 1 - j : j) * stride;
+        if (flip_x) reverse_row(from, to, stride, width);
+        else memcpy(to, from, stride * sizeof(uint64_t));
+    }
+    return dst;
+}
+
+/* Purpose: reverse_row writes a row of bits in reverse order. Reversing
+ *          every word and their order puts bit b at position
+ *          64 * nwords - 1 - b, so the result is shifted right by the
+ *          number of padding bits to land it at width - 1 - b
+ * I: The source row's words, a destination for the same number of words
+ *    (not overlapping), the number of words, and the width
+ * O: N/A
+ */
+static void reverse_row(const uint64_t *src, uint64_t *dst, int nwords,
+                        int width)
+{
+    int pad = nwords * 64 - width;
+    int k;
+    for (k = 0; k < nwords; k++) {
+        uint64_t word = reverse64(src[nwords - 1 - k]);
+        if (pad == 0) {
+            dst[k] = word;
+            continue;
+        }
+        dst[k] = word >> pad;
+        if (k + 1 < nwords)
+            dst[k] |= reverse64(src[nwords - 2 - k]) << (64 - pad);
+    }
+}
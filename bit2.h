@@ -12,31 +12,77 @@
 
 #ifndef BIT2_INCLUDED
 #define BIT2_INCLUDED
-#include "bit.h"
+#include <stdint.h>
 #include "assert.h"
+#include "arena.h"
 
 #define T Bit2_T
 typedef struct T *T;
 
-/* Bit2_T is composed of a 1D Hanson Bit Vector */
+/* where the storage of a Bit2_T came from, which decides what Bit2_free
+ * releases
+ */
+enum Bit2_owner {
+    BIT2_HEAP,          /* struct and bits malloc'd by Bit2_new */
+    BIT2_ARENA,         /* struct and bits live in an Arena_T */
+    BIT2_WRAPPED        /* bits belong to the caller */
+};
+
+/* Bit2_T stores its bits in 64-bit words, one row after another, and every
+ * row starts on a new word: bit [i, j] is bit i % 64 of word
+ * j * stride + i / 64. The bits of the last word of a row past the width
+ * are padding and are always 0, so a row can be scanned, compared, or
+ * combined a whole word at a time
+ */
 struct T {
     int width;
     int height;
-    Bit_T array;
+    int stride;             /* words per row, (width + 63) / 64 */
+    uint64_t *words;
+    enum Bit2_owner owner;
 };
 
 /* exported functions */
 
 /* Purpose: Bit2_new instantiates a Bit2_T object, allocates adequate
  *          memory for it, and initializes the struct variables using
- *          the parameters and the Hanson Bit_new function
+ *          the parameters. All bits start at 0
  * I: Two nonnegative integer values representing the width and
  *    height of the bit map.
  * O: A Bit2_T object
  */
 T Bit2_new(int row, int col);
 
-/* Purpose: Bit2_free frees memory allocated for the Bit2_T's array varaible
+/* Purpose: Bit2_new_in is Bit2_new with the Bit2_T and its bits allocated
+ *          from an arena, so that many short-lived bit maps cost one
+ *          allocation each and can all be released at once with
+ *          Arena_free(arena). Bit2_free on such a map only clears the
+ *          caller's pointer
+ * I: An existing Arena_T, and the width and height as for Bit2_new
+ * O: A Bit2_T object that lives as long as the arena's current contents
+ */
+T Bit2_new_in(Arena_T arena, int row, int col);
+
+/* Purpose: Bit2_wrap makes a Bit2_T over a caller-owned buffer without
+ *          copying it. The buffer holds the bits in the layout described
+ *          above and keeps its contents. Bit2_free frees the Bit2_T but
+ *          never the buffer
+ * I: A nonnull buffer of at least Bit2_buffer_size(row, col) bytes, aligned
+ *    for a uint64_t, and the width and height
+ * O: A Bit2_T object whose bits are the buffer
+ */
+T Bit2_wrap(void *bits, int row, int col);
+
+/* Purpose: Bit2_buffer_size returns how many bytes of storage a bit map of
+ *          the given size needs, padding included, for callers preparing a
+ *          buffer to wrap
+ * I: Two nonnegative integers representing the width and height
+ * O: The number of bytes
+ */
+long Bit2_buffer_size(int row, int col);
+
+/* Purpose: Bit2_free frees memory allocated for the Bit2_T and, if Bit2_new
+ *          allocated them, its bits
  * I: A nonnull pointer to a Bit2_T object
  * O: N/A
  */
@@ -62,8 +108,8 @@ int Bit2_height(T bit2);
 float Bit2_size(T bit2);
 
 /* Purpose: Bit2_get retrieves the value in the specified row and col
- *          position in the bit map by accessing the corresponding index
- *          in the 1D Bit Vector
+ *          position in the bit map by accessing the corresponding bit
+ *          of the packed storage
  * I: An existing and initialized Bit2_T object, and a [row, column] position
  *    within that object (defined by row and col respectively). These
  *    positions must be both nonnegative and less than the max width and
@@ -84,6 +130,56 @@ int Bit2_get(T bit2, int row, int col);
  */
 int Bit2_put(T bit2, int row, int col, int bit);
 
+/* Purpose: Bit2_words_per_row returns the number of 64-bit words each row
+ *          of a given Bit2_T is stored in
+ * I: An existing and initialized Bit2_T object
+ * O: (width + 63) / 64
+ */
+int Bit2_words_per_row(T bit2);
+
+/* Purpose: Bit2_get_word returns word k of row j, which holds bits
+ *          [64 * k, j] .. [64 * k + 63, j]; bit b of the word is
+ *          [64 * k + b, j]. Bits past the width read as 0
+ * I: An existing and initialized Bit2_T object, a word number k that is
+ *    nonnegative and less than Bit2_words_per_row, and a row number j that
+ *    is nonnegative and less than the height
+ * O: The 64 bits
+ */
+uint64_t Bit2_get_word(T bit2, int k, int j);
+
+/* Purpose: Bit2_put_word replaces word k of row j (laid out as for
+ *          Bit2_get_word) with a given word. Bits past the width are
+ *          dropped, so the padding stays 0
+ * I: An existing and initialized Bit2_T object, a word number and row
+ *    number as for Bit2_get_word, and the 64 bits to store
+ * O: The word that was there before
+ */
+uint64_t Bit2_put_word(T bit2, int k, int j, uint64_t word);
+
+/* Purpose: Bit2_row_words returns a pointer to the words of row j, laid out
+ *          as for Bit2_get_word, so callers can run their own loop over a
+ *          row. Callers writing through it must leave the padding bits 0
+ * I: An existing and initialized Bit2_T object, a row number j that is
+ *    nonnegative and less than the height, and a pointer that receives the
+ *    number of words in the row (may be NULL)
+ * O: A pointer to word 0 of row j
+ */
+uint64_t *Bit2_row_words(T bit2, int j, int *nwords);
+
+/* Purpose: Bit2_map_row_words applies a certain function to every row of a
+ *          given Bit2_T object, top to bottom, handing it the row's words
+ *          (laid out as for Bit2_get_word) so it can work on 64 bits at a
+ *          time. The apply function may change the words; any padding bits
+ *          it sets are cleared again after it returns
+ * I: An existing and initialized Bit2_T object, an apply function that takes
+ *    in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void Bit2_map_row_words(T bit2,
+                        void apply(int j, T bit2, uint64_t *words,
+                        int nwords, void *cl), void *cl);
+
 /* Purpose: Bit2_map_row_major applies a certain function to all of the
  *          elements within a given Bit2_T object, iterating through the
  *          object one row at a time.
@@ -96,6 +192,65 @@ void Bit2_map_row_major(T bit2,
                         void apply(int row, int col, T bit2, int elem,
                         void *cl), void *cl);
 
+/* Purpose: Bit2_map_row_major_par applies a certain function to all of the
+ *          bits of a given Bit2_T object on nthreads threads from the shared
+ *          Pool_T. The rows are split into nthreads bands of consecutive
+ *          rows and band k is visited in row-major order with cls[k] as its
+ *          closure. Band edges are moved down to rows that start on a
+ *          64-byte boundary of the word block (which Bit2_new and
+ *          Bit2_new_in align to a cache line), so no two bands ever write
+ *          the same word or cache line. Once every band is done, reduce (if
+ *          not NULL) is called as reduce(cls[0], cls[k]) for k = 1 ..
+ *          nthreads - 1 in that order. apply may only change the bit it is
+ *          given, with Bit2_put
+ * I: An existing and initialized Bit2_T object, an apply function that takes
+ *    in the parameters specified below, an array of nthreads closures (or
+ *    NULL, in which case every worker gets NULL), a positive number of
+ *    threads, and a reduce function (or NULL)
+ * O: N/A
+ */
+void Bit2_map_row_major_par(T bit2,
+                            void apply(int row, int col, T bit2, int elem,
+                            void *cl), void *cls[], int nthreads,
+                            void reduce(void *cl, void *worker_cl));
+
+/* Purpose: Bit2_map_row_major_const_par is Bit2_map_row_major_par for apply
+ *          functions that only read the bit map. Since nothing is written,
+ *          the words are split evenly into nthreads chunks of whole cache
+ *          lines instead of whole rows, so a map with few, very long rows
+ *          still uses every thread. Chunk k is visited in row-major order
+ *          with cls[k] as its closure, and the results are merged with
+ *          reduce as for Bit2_map_row_major_par
+ * I: An existing and initialized Bit2_T object, an apply function that takes
+ *    in the parameters specified below and does not change the Bit2_T, an
+ *    array of nthreads closures (or NULL), a positive number of threads,
+ *    and a reduce function (or NULL)
+ * O: N/A
+ */
+void Bit2_map_row_major_const_par(T bit2,
+                                  void apply(int row, int col, T bit2,
+                                  int elem, void *cl), void *cls[],
+                                  int nthreads,
+                                  void reduce(void *cl, void *worker_cl));
+
+/* Purpose: Bit2_map_runs calls a certain function once for every maximal
+ *          run of 1 bits in a given Bit2_T object, row by row from the top
+ *          and left to right within a row. Runs are found a word at a time
+ *          by counting trailing zeros, so a pass costs time in proportion
+ *          to the number of runs, not the number of pixels. A run never
+ *          continues from one row to the next
+ * I: An existing and initialized Bit2_T object, an apply function that takes
+ *    the position [i, j] of the first bit of a run and the run's length
+ *    (at least 1), the Bit2_T, and the closure; and a void pointer to carry
+ *    certain values over between function calls. Each word is read when
+ *    the scan reaches it, so apply may change bits it has already been
+ *    handed
+ * O: N/A
+ */
+void Bit2_map_runs(T bit2,
+                   void apply(int i, int j, int len, T bit2, void *cl),
+                   void *cl);
+
 /* Purpose: Bit2_map_col_major applies a certain function to all of the
  *          elements within a given Bit2_T object, iterating through the
  *          object one row at a time.
@@ -109,5 +264,139 @@ void Bit2_map_col_major(T bit2,
                         void *cl), void *cl);
 
 
+/* Purpose: Bit2_transpose returns a new Bit2_T holding the transpose of a
+ *          given one: bit [i, j] of the source is bit [j, i] of the result.
+ *          The bits are moved 64 at a time by transposing 8 x 8 bit
+ *          matrices, and those are visited in 64 x 64 tiles so the rows of
+ *          both bit maps being touched stay in cache
+ * I: An existing and initialized Bit2_T object
+ * O: A new height x width Bit2_T, freed with Bit2_free
+ */
+T Bit2_transpose(T bit2);
+
+/* Purpose: Bit2_rotate90 returns a new Bit2_T holding a given one rotated
+ *          90 degrees clockwise, so bit [i, j] of the source is bit
+ *          [height - 1 - j, i] of the result. It uses the same tiled 8 x 8
+ *          kernel as Bit2_transpose
+ * I: An existing and initialized Bit2_T object
+ * O: A new height x width Bit2_T, freed with Bit2_free
+ */
+T Bit2_rotate90(T bit2);
+
+/* Purpose: Bit2_rotate180 returns a new Bit2_T holding a given one rotated
+ *          180 degrees, so bit [i, j] of the source is bit
+ *          [width - 1 - i, height - 1 - j] of the result
+ * I: An existing and initialized Bit2_T object
+ * O: A new width x height Bit2_T, freed with Bit2_free
+ */
+T Bit2_rotate180(T bit2);
+
+/* Purpose: Bit2_rotate270 returns a new Bit2_T holding a given one rotated
+ *          270 degrees clockwise, so bit [i, j] of the source is bit
+ *          [j, width - 1 - i] of the result. It uses the same tiled 8 x 8
+ *          kernel as Bit2_transpose
+ * I: An existing and initialized Bit2_T object
+ * O: A new height x width Bit2_T, freed with Bit2_free
+ */
+T Bit2_rotate270(T bit2);
+
+/* Purpose: Bit2_flip_horizontal returns a new Bit2_T holding a given one
+ *          mirrored left to right, so bit [i, j] of the source is bit
+ *          [width - 1 - i, j] of the result
+ * I: An existing and initialized Bit2_T object
+ * O: A new width x height Bit2_T, freed with Bit2_free
+ */
+T Bit2_flip_horizontal(T bit2);
+
+/* Purpose: Bit2_flip_vertical returns a new Bit2_T holding a given one
+ *          mirrored top to bottom, so bit [i, j] of the source is bit
+ *          [i, height - 1 - j] of the result
+ * I: An existing and initialized Bit2_T object
+ * O: A new width x height Bit2_T, freed with Bit2_free
+ */
+T Bit2_flip_vertical(T bit2);
+
+
+/* Purpose: Bit2_and, Bit2_or, and Bit2_xor set every bit of dst to the
+ *          and, or, or exclusive or of the same bit of a and b. They work
+ *          on whole rows of words with the vector kernels in bitvec.c
+ * I: Three existing and initialized Bit2_T objects of the same width and
+ *    height; dst may be a or b
+ * O: N/A
+ */
+void Bit2_and(T dst, T a, T b);
+void Bit2_or(T dst, T a, T b);
+void Bit2_xor(T dst, T a, T b);
+
+/* Purpose: Bit2_not sets every bit of dst to the complement of the same bit
+ *          of src
+ * I: Two existing and initialized Bit2_T objects of the same width and
+ *    height; dst may be src
+ * O: N/A
+ */
+void Bit2_not(T dst, T src);
+
+/* Purpose: Bit2_count counts the bits of a Bit2_T that are 1
+ * I: An existing and initialized Bit2_T object
+ * O: The number of 1 bits
+ */
+long Bit2_count(T bit2);
+
+/* Purpose: Bit2_equal compares two Bit2_T objects, stopping at the first
+ *          word that differs
+ * I: Two existing and initialized Bit2_T objects
+ * O: 1 if they have the same width, height, and bits, 0 otherwise
+ */
+int Bit2_equal(T a, T b);
+
+/* Purpose: Bit2_and_rect, Bit2_or_rect, and Bit2_xor_rect combine the
+ *          w x h rectangle of src whose top left bit is [sx, sy] into the
+ *          one of dst whose top left bit is [dx, dy]: bit [dx + i, dy + j]
+ *          of dst becomes itself and, or, or exclusive or bit
+ *          [sx + i, sy + j] of src. Bits of dst outside the rectangle are
+ *          left alone. The rectangles need not start on the same bit of a
+ *          word; each source row is shifted into line with the destination
+ *          and then combined a vector at a time
+ * I: An existing and initialized destination Bit2_T and the position of
+ *    its rectangle, an existing and initialized source Bit2_T (may be dst,
+ *    and the rectangles may overlap) and the position of its rectangle, and
+ *    the nonnegative width and height of the rectangles, which must lie
+ *    inside both maps
+ * O: N/A
+ */
+void Bit2_and_rect(T dst, int dx, int dy, T src, int sx, int sy,
+                   int w, int h);
+void Bit2_or_rect(T dst, int dx, int dy, T src, int sx, int sy,
+                  int w, int h);
+void Bit2_xor_rect(T dst, int dx, int dy, T src, int sx, int sy,
+                   int w, int h);
+
+/* Purpose: Bit2_not_rect sets the w x h rectangle of dst whose top left bit
+ *          is [dx, dy] to the complement of the one of src whose top left
+ *          bit is [sx, sy]
+ * I: As for Bit2_and_rect
+ * O: N/A
+ */
+void Bit2_not_rect(T dst, int dx, int dy, T src, int sx, int sy,
+                   int w, int h);
+
+/* Purpose: Bit2_count_rect counts the 1 bits in the w x h rectangle of a
+ *          Bit2_T whose top left bit is [x, y]
+ * I: An existing and initialized Bit2_T object, and the position and
+ *    nonnegative size of a rectangle inside it
+ * O: The number of 1 bits
+ */
+long Bit2_count_rect(T bit2, int x, int y, int w, int h);
+
+/* Purpose: Bit2_equal_rect compares the w x h rectangle of a whose top left
+ *          bit is [ax, ay] with the one of b whose top left bit is [bx, by]
+ * I: Two existing and initialized Bit2_T objects, the positions of the
+ *    rectangles, and their nonnegative width and height, which must lie
+ *    inside both maps
+ * O: 1 if every bit of the rectangles is the same, 0 otherwise
+ */
+int Bit2_equal_rect(T a, int ax, int ay, T b, int bx, int by, int w, int h);
+
+
 #undef T
 #endif
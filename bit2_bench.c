@@ -0,0 +1,385 @@
+/*
+ *      bit2_bench.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This program times the Bit2_T transpose, rotate, and flip functions
+ *      against naive copies that move one bit at a time with Bit2_get and
+ *      Bit2_put, and checks that both give the same bit map. It then does
+ *      the same for the whole-map boolean operations, count, and compare,
+ *      using whichever bitvec kernels the processor supports (set
+ *      BITVEC_KERNELS=scalar or sse2 to time the fallbacks), and times
+ *      Bit2_map_row_major against Bit2_map_col_major. Last, it
+ *      counts the ink on a mostly white page with Bit2_map_row_major and
+ *      with Bit2_map_runs, and times both parallel map functions on
+ *      1 .. threads threads (default: one per processor), and prints the
+ *      peak memory of the process.
+ *
+ *      Usage: bit2_bench [width height [threads]]
+ */
+
+#define _POSIX_C_SOURCE 199309L  /* for clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "bit2.h"
+#include "bitvec.h"
+#include "pool.h"
+#include "assert.h"
+
+/* the reorientations being timed, in the order they are reported */
+enum orient { TRANSPOSE, ROTATE90, ROTATE180, ROTATE270, FLIP_H, FLIP_V };
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+double now(void);
+Bit2_T naive(Bit2_T bit2, enum orient how);
+int same(Bit2_T a, Bit2_T b);
+void ops(Bit2_T a);
+void orders(Bit2_T bit2);
+void runs(int width, int height);
+void count_pixel(int i, int j, Bit2_T bit2, int elem, void *cl);
+void count_run(int i, int j, int len, Bit2_T bit2, void *cl);
+void scaling(Bit2_T bit2, int maxthreads);
+void add_counts(void *cl, void *worker_cl);
+void compare(const char *name, double naive_sec, double fast_sec, long cells,
+             int agree);
+void report(const char *name, double seconds, long cells);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int main(int argc, char *argv[])
+{
+    static const char *names[] = { "transpose", "rotate90", "rotate180",
+                                   "rotate270", "flip_horizontal",
+                                   "flip_vertical" };
+    static Bit2_T (*const fast[])(Bit2_T) = {
+        Bit2_transpose, Bit2_rotate90, Bit2_rotate180, Bit2_rotate270,
+        Bit2_flip_horizontal, Bit2_flip_vertical
+    };
+    int width = 8000, height = 8000, maxthreads = Pool_ncpus();
+    if (argc >= 3) {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    if (argc >= 4) maxthreads = atoi(argv[3]);
+    if (width <= 0 || height <= 0 || maxthreads <= 0) {
+        fprintf(stderr, "usage: %s [width height [threads]]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    long cells = (long)width * height;
+    Bit2_T bit2 = Bit2_new(width, height);
+    int i, j, how;
+    srand(40);
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            Bit2_put(bit2, i, j, rand() & 1);
+
+    printf("bit2 %d x %d%28s%22s\n", width, height, "naive", "kernel");
+    for (how = TRANSPOSE; how <= FLIP_V; how++) {
+        double start = now();
+        Bit2_T slow = naive(bit2, how);
+        double naive_sec = now() - start;
+
+        start = now();
+        Bit2_T quick = fast[how](bit2);
+        double fast_sec = now() - start;
+
+        compare(names[how], naive_sec, fast_sec, cells, same(slow, quick));
+        Bit2_free(&slow);
+        Bit2_free(&quick);
+    }
+
+    ops(bit2);
+    orders(bit2);
+    scaling(bit2, maxthreads);
+    Bit2_free(&bit2);
+    runs(width, height);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        printf("peak rss %ld kB\n", usage.ru_maxrss);
+    exit(EXIT_SUCCESS);
+}
+
+/* Purpose: ops times Bit2_and, Bit2_not, Bit2_count, and Bit2_equal against
+ *          loops over Bit2_get and Bit2_put
+ * I: An existing and initialized Bit2_T object holding random bits
+ * O: N/A
+ */
+void ops(Bit2_T a)
+{
+    int width = Bit2_width(a), height = Bit2_height(a);
+    long cells = (long)width * height;
+    Bit2_T b = Bit2_flip_horizontal(a);
+    Bit2_T slow = Bit2_new(width, height), quick = Bit2_new(width, height);
+    long slow_count = 0, quick_count;
+    int slow_equal = 1, quick_equal;
+    double start, naive_sec;
+    int i, j;
+
+    printf("bitvec kernels: %s\n", Bitvec_kernels());
+
+    start = now();
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            Bit2_put(slow, i, j, Bit2_get(a, i, j) & Bit2_get(b, i, j));
+    naive_sec = now() - start;
+    start = now();
+    Bit2_and(quick, a, b);
+    compare("and", naive_sec, now() - start, cells, Bit2_equal(slow, quick));
+
+    start = now();
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            Bit2_put(slow, i, j, !Bit2_get(a, i, j));
+    naive_sec = now() - start;
+    start = now();
+    Bit2_not(quick, a);
+    compare("not", naive_sec, now() - start, cells, Bit2_equal(slow, quick));
+
+    start = now();
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            slow_count += Bit2_get(a, i, j);
+    naive_sec = now() - start;
+    start = now();
+    quick_count = Bit2_count(a);
+    compare("count", naive_sec, now() - start, cells,
+            slow_count == quick_count);
+
+    /* identical maps, so both have to look at every bit */
+    Bit2_not(quick, slow);
+    start = now();
+    for (j = 0; j < height && slow_equal; j++)
+        for (i = 0; i < width; i++)
+            if (Bit2_get(a, i, j) != Bit2_get(quick, i, j)) slow_equal = 0;
+    naive_sec = now() - start;
+    start = now();
+    quick_equal = Bit2_equal(a, quick);
+    compare("equal", naive_sec, now() - start, cells,
+            slow_equal == quick_equal && quick_equal);
+
+    Bit2_free(&b);
+    Bit2_free(&slow);
+    Bit2_free(&quick);
+}
+
+/* Purpose: orders times counting the 1 bits of a map with
+ *          Bit2_map_row_major and with Bit2_map_col_major, which visit the
+ *          same bits in the two orders
+ * I: An existing and initialized Bit2_T object
+ * O: N/A
+ */
+void orders(Bit2_T bit2)
+{
+    long cells = (long)Bit2_width(bit2) * Bit2_height(bit2);
+    long by_row = 0, by_col = 0;
+    double start;
+
+    start = now();
+    Bit2_map_row_major(bit2, count_pixel, &by_row);
+    report("map_row_major", now() - start, cells);
+
+    start = now();
+    Bit2_map_col_major(bit2, count_pixel, &by_col);
+    report("map_col_major", now() - start, cells);
+    if (by_row != by_col)
+        printf("map orders MISMATCH\n");
+}
+
+/* Purpose: runs times counting the 1 bits of a page that is about 95%
+ *          white (short horizontal strokes of ink) with Bit2_map_row_major
+ *          and with Bit2_map_runs
+ * I: The width and height of the page
+ * O: N/A
+ */
+void runs(int width, int height)
+{
+    Bit2_T page = Bit2_new(width, height);
+    long cells = (long)width * height;
+    long by_pixel = 0, by_run = 0;
+    double start, naive_sec;
+    int i, j, len;
+
+    for (j = 0; j < height; j++) {
+        for (i = rand() % 200; i < width; i += 100 + rand() % 200) {
+            for (len = 2 + rand() % 16; len > 0 && i < width; len--, i++)
+                Bit2_put(page, i, j, 1);
+        }
+    }
+
+    printf("page with %.1f%% ink\n", 100.0 * Bit2_count(page) / cells);
+    start = now();
+    Bit2_map_row_major(page, count_pixel, &by_pixel);
+    naive_sec = now() - start;
+    start = now();
+    Bit2_map_runs(page, count_run, &by_run);
+    compare("map_runs", naive_sec, now() - start, cells, by_pixel == by_run);
+    Bit2_free(&page);
+}
+
+/* Purpose: count_pixel is the Bit2_map_row_major apply function for runs;
+ *          it adds each bit to a running count
+ * I: A position, the Bit2_T, the bit, and a pointer to the count
+ * O: N/A
+ */
+void count_pixel(int i, int j, Bit2_T bit2, int elem, void *cl)
+{
+    (void) i;
+    (void) j;
+    (void) bit2;
+    *(long *)cl += elem;
+}
+
+/* Purpose: count_run is the Bit2_map_runs apply function for runs; it adds
+ *          each run's length to a running count
+ * I: The position of the run's first bit, its length, the Bit2_T, and a
+ *    pointer to the count
+ * O: N/A
+ */
+void count_run(int i, int j, int len, Bit2_T bit2, void *cl)
+{
+    (void) i;
+    (void) j;
+    (void) bit2;
+    *(long *)cl += len;
+}
+
+/* Purpose: scaling times both parallel map functions counting the 1 bits
+ *          of a map on every thread count from 1 to maxthreads and prints
+ *          the speedup over one thread
+ * I: An existing and initialized Bit2_T object and the largest number of
+ *    threads to try
+ * O: N/A
+ */
+void scaling(Bit2_T bit2, int maxthreads)
+{
+    long cells = (long)Bit2_width(bit2) * Bit2_height(bit2);
+    long expect = Bit2_count(bit2);
+    long *counts = (long *)malloc(maxthreads * sizeof(long));
+    void **cls = (void **)malloc(maxthreads * sizeof(void *));
+    double row_one = 0, const_one = 0;
+    int n, k;
+    assert(counts && cls);
+
+    for (n = 1; n <= maxthreads; n++) {
+        double start, row, by_word;
+        for (k = 0; k < n; k++) {
+            counts[k] = 0;
+            cls[k] = &counts[k];
+        }
+        start = now();
+        Bit2_map_row_major_par(bit2, count_pixel, cls, n, add_counts);
+        row = now() - start;
+        int row_ok = counts[0] == expect;
+
+        for (k = 0; k < n; k++) counts[k] = 0;
+        start = now();
+        Bit2_map_row_major_const_par(bit2, count_pixel, cls, n, add_counts);
+        by_word = now() - start;
+        int const_ok = counts[0] == expect;
+
+        if (n == 1) {
+            row_one = row;
+            const_one = by_word;
+        }
+        printf("threads %-3d row_par %6.3f ns/bit x%.2f  "
+               "const_par %6.3f ns/bit x%.2f%s\n", n, row * 1e9 / cells,
+               row_one / row, by_word * 1e9 / cells, const_one / by_word,
+               row_ok && const_ok ? "" : "  MISMATCH");
+    }
+    free(cls);
+    free(counts);
+}
+
+/* Purpose: add_counts is the reduce function for the parallel maps
+ * I: Pointers to the count being merged into and a worker's count
+ * O: N/A
+ */
+void add_counts(void *cl, void *worker_cl)
+{
+    *(long *)cl += *(long *)worker_cl;
+}
+
+/* Purpose: compare prints one line of naive against kernel timings
+ * I: The name of the case, the naive and kernel times in seconds, the number
+ *    of bits covered, and whether the two gave the same answer
+ * O: N/A
+ */
+void compare(const char *name, double naive_sec, double fast_sec, long cells,
+             int agree)
+{
+    printf("%-16s %10.3f ms %6.3f ns/bit %10.3f ms %6.3f ns/bit  x%.1f%s\n",
+           name, naive_sec * 1e3, naive_sec * 1e9 / cells, fast_sec * 1e3,
+           fast_sec * 1e9 / cells, naive_sec / fast_sec,
+           agree ? "" : "  MISMATCH");
+}
+
+/* Purpose: report prints one timing line
+ * I: The name of the case, the time it took in seconds, and the number of
+ *    bits it covered
+ * O: N/A
+ */
+void report(const char *name, double seconds, long cells)
+{
+    printf("%-16s %10.3f ms %6.3f ns/bit\n", name, seconds * 1e3,
+           seconds * 1e9 / cells);
+}
+
+/* Purpose: naive reorients a Bit2_T one bit at a time
+ * I: An existing and initialized Bit2_T object and the reorientation
+ * O: A new Bit2_T
+ */
+Bit2_T naive(Bit2_T bit2, enum orient how)
+{
+    int width = Bit2_width(bit2), height = Bit2_height(bit2);
+    int swaps = how == TRANSPOSE || how == ROTATE90 || how == ROTATE270;
+    Bit2_T dst = swaps ? Bit2_new(height, width) : Bit2_new(width, height);
+    int i, j;
+
+    for (j = 0; j < height; j++) {
+        for (i = 0; i < width; i++) {
+            int bit = Bit2_get(bit2, i, j);
+            switch (how) {
+            case TRANSPOSE: Bit2_put(dst, j, i, bit); break;
+            case ROTATE90:  Bit2_put(dst, height - 1 - j, i, bit); break;
+            case ROTATE180:
+                Bit2_put(dst, width - 1 - i, height - 1 - j, bit);
+                break;
+            case ROTATE270: Bit2_put(dst, j, width - 1 - i, bit); break;
+            case FLIP_H:    Bit2_put(dst, width - 1 - i, j, bit); break;
+            case FLIP_V:    Bit2_put(dst, i, height - 1 - j, bit); break;
+            }
+        }
+    }
+    return dst;
+}
+
+/* Purpose: same compares two Bit2_T objects bit by bit
+ * I: Two existing and initialized Bit2_T objects
+ * O: 1 if they have the same dimensions and bits, 0 otherwise
+ */
+int same(Bit2_T a, Bit2_T b)
+{
+    int width = Bit2_width(a), height = Bit2_height(a);
+    int i, j;
+    if (width != Bit2_width(b) || height != Bit2_height(b)) return 0;
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            if (Bit2_get(a, i, j) != Bit2_get(b, i, j)) return 0;
+    return 1;
+}
+
+/* Purpose: now returns the current time of a monotonic clock
+ * I: N/A
+ * O: The current time in seconds
+ */
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
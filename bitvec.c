@@ -0,0 +1,345 @@
+/*
+ *      bitvec.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code includes the function definitions for all the functions
+ *      declared in bitvec.h. The x86 kernels are compiled with GCC target
+ *      attributes, so the rest of the program does not need -mavx2 and
+ *      still runs on processors without it
+ */
+
+#define _POSIX_C_SOURCE 200112L  /* for pthread_once */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bitvec.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BITVEC_X86 1
+#include <immintrin.h>
+#endif
+
+/* one complete set of kernels; selected is filled in by choose */
+struct kernels {
+    const char *name;
+    void (*and)(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n);
+    void (*or)(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n);
+    void (*xor)(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n);
+    void (*not)(uint64_t *dst, const uint64_t *a, long n);
+    long (*count)(const uint64_t *a, long n);
+    int (*equal)(const uint64_t *a, const uint64_t *b, long n);
+};
+
+static struct kernels selected;
+static pthread_once_t chosen = PTHREAD_ONCE_INIT;
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+static void choose(void);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose: Bitvec_and stores a[k] & b[k] in dst[k] for every k < n
+ * I: The destination and two sources of n words each; dst may be a or b
+ * O: N/A
+ */
+void Bitvec_and(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n)
+{
+    pthread_once(&chosen, choose);
+    selected.and(dst, a, b, n);
+}
+
+/* Purpose: Bitvec_or stores a[k] | b[k] in dst[k] for every k < n
+ * I: The destination and two sources of n words each; dst may be a or b
+ * O: N/A
+ */
+void Bitvec_or(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n)
+{
+    pthread_once(&chosen, choose);
+    selected.or(dst, a, b, n);
+}
+
+/* Purpose: Bitvec_xor stores a[k] ^ b[k] in dst[k] for every k < n
+ * I: The destination and two sources of n words each; dst may be a or b
+ * O: N/A
+ */
+void Bitvec_xor(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n)
+{
+    pthread_once(&chosen, choose);
+    selected.xor(dst, a, b, n);
+}
+
+/* Purpose: Bitvec_not stores ~a[k] in dst[k] for every k < n
+ * I: The destination and source of n words each; dst may be a
+ * O: N/A
+ */
+void Bitvec_not(uint64_t *dst, const uint64_t *a, long n)
+{
+    pthread_once(&chosen, choose);
+    selected.not(dst, a, n);
+}
+
+/* Purpose: Bitvec_count counts the set bits in n words
+ * I: The words and how many there are
+ * O: The number of 1 bits
+ */
+long Bitvec_count(const uint64_t *a, long n)
+{
+    pthread_once(&chosen, choose);
+    return selected.count(a, n);
+}
+
+/* Purpose: Bitvec_equal compares n words, stopping at the first difference
+ * I: Two runs of n words
+ * O: 1 if every word is the same, 0 otherwise
+ */
+int Bitvec_equal(const uint64_t *a, const uint64_t *b, long n)
+{
+    pthread_once(&chosen, choose);
+    return selected.equal(a, b, n);
+}
+
+/* Purpose: Bitvec_kernels names the set of kernels in use, choosing them if
+ *          no kernel has been called yet
+ * I: N/A
+ * O: "avx2", "sse2", or "scalar"
+ */
+const char *Bitvec_kernels(void)
+{
+    pthread_once(&chosen, choose);
+    return selected.name;
+}
+
+/* * * * * * * * * * * * * * * * scalar kernels * * * * * * * * * * * * * * */
+
+/* the element-wise kernels all have the same shape, so each set of kernels
+ * generates its and, or, and xor from one macro
+ */
+#define SCALAR_BINARY(NAME, OP)                                               \
+static void NAME##_scalar(uint64_t *dst, const uint64_t *a,                  \
+                          const uint64_t *b, long n)                         \
+{                                                                            \
+    long k;                                                                  \
+    for (k = 0; k < n; k++) dst[k] = a[k] OP b[k];                           \
+}
+
+SCALAR_BINARY(and, &)
+SCALAR_BINARY(or, |)
+SCALAR_BINARY(xor, ^)
+
+/* Purpose: not_scalar is the portable Bitvec_not */
+static void not_scalar(uint64_t *dst, const uint64_t *a, long n)
+{
+    long k;
+    for (k = 0; k < n; k++) dst[k] = ~a[k];
+}
+
+/* Purpose: popcount64 counts the set bits in a word by adding neighboring
+ *          fields of 1, 2, and 4 bits, then summing the bytes with a multiply
+ * I: A word
+ * O: The number of 1 bits
+ */
+static inline int popcount64(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+/* Purpose: count_scalar is the portable Bitvec_count */
+static long count_scalar(const uint64_t *a, long n)
+{
+    long k, total = 0;
+    for (k = 0; k < n; k++) total += popcount64(a[k]);
+    return total;
+}
+
+/* Purpose: equal_scalar is the portable Bitvec_equal */
+static int equal_scalar(const uint64_t *a, const uint64_t *b, long n)
+{
+    return memcmp(a, b, n * sizeof(uint64_t)) == 0;
+}
+
+static const struct kernels scalar = {
+    "scalar", and_scalar, or_scalar, xor_scalar, not_scalar, count_scalar,
+    equal_scalar
+};
+
+#ifdef BITVEC_X86
+
+/* * * * * * * * * * * * * * * * * SSE2 kernels * * * * * * * * * * * * * * */
+
+#define SSE2_BINARY(NAME, VOP, OP)                                            \
+__attribute__((target("sse2")))                                              \
+static void NAME##_sse2(uint64_t *dst, const uint64_t *a,                    \
+                        const uint64_t *b, long n)                           \
+{                                                                            \
+    long k = 0;                                                              \
+    for (; k + 2 <= n; k += 2) {                                             \
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + k));               \
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + k));               \
+        _mm_storeu_si128((__m128i *)(dst + k), VOP(x, y));                   \
+    }                                                                        \
+    for (; k < n; k++) dst[k] = a[k] OP b[k];                                \
+}
+
+SSE2_BINARY(and, _mm_and_si128, &)
+SSE2_BINARY(or, _mm_or_si128, |)
+SSE2_BINARY(xor, _mm_xor_si128, ^)
+
+/* Purpose: not_sse2 is the SSE2 Bitvec_not */
+__attribute__((target("sse2")))
+static void not_sse2(uint64_t *dst, const uint64_t *a, long n)
+{
+    __m128i ones = _mm_set1_epi32(-1);
+    long k = 0;
+    for (; k + 2 <= n; k += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + k));
+        _mm_storeu_si128((__m128i *)(dst + k), _mm_xor_si128(x, ones));
+    }
+    for (; k < n; k++) dst[k] = ~a[k];
+}
+
+/* Purpose: count_popcnt is Bitvec_count using the POPCNT instruction, which
+ *          arrived with SSE4.2 and is checked for separately
+ */
+__attribute__((target("popcnt")))
+static long count_popcnt(const uint64_t *a, long n)
+{
+    long k, total = 0;
+    for (k = 0; k < n; k++) total += __builtin_popcountll(a[k]);
+    return total;
+}
+
+/* Purpose: equal_sse2 is the SSE2 Bitvec_equal; it compares 16 bytes at a
+ *          time and stops at the first block that differs
+ */
+__attribute__((target("sse2")))
+static int equal_sse2(const uint64_t *a, const uint64_t *b, long n)
+{
+    long k = 0;
+    for (; k + 2 <= n; k += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + k));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + k));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) return 0;
+    }
+    for (; k < n; k++)
+        if (a[k] != b[k]) return 0;
+    return 1;
+}
+
+/* * * * * * * * * * * * * * * * * AVX2 kernels * * * * * * * * * * * * * * */
+
+#define AVX2_BINARY(NAME, VOP, OP)                                            \
+__attribute__((target("avx2")))                                              \
+static void NAME##_avx2(uint64_t *dst, const uint64_t *a,                    \
+                        const uint64_t *b, long n)                           \
+{                                                                            \
+    long k = 0;                                                              \
+    for (; k + 4 <= n; k += 4) {                                             \
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + k));            \
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + k));            \
+        _mm256_storeu_si256((__m256i *)(dst + k), VOP(x, y));                \
+    }                                                                        \
+    for (; k < n; k++) dst[k] = a[k] OP b[k];                                \
+}
+
+AVX2_BINARY(and, _mm256_and_si256, &)
+AVX2_BINARY(or, _mm256_or_si256, |)
+AVX2_BINARY(xor, _mm256_xor_si256, ^)
+
+/* Purpose: not_avx2 is the AVX2 Bitvec_not */
+__attribute__((target("avx2")))
+static void not_avx2(uint64_t *dst, const uint64_t *a, long n)
+{
+    __m256i ones = _mm256_set1_epi32(-1);
+    long k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + k));
+        _mm256_storeu_si256((__m256i *)(dst + k), _mm256_xor_si256(x, ones));
+    }
+    for (; k < n; k++) dst[k] = ~a[k];
+}
+
+/* Purpose: count_avx2 is the AVX2 Bitvec_count. Each nibble is looked up
+ *          in a 16-entry table of bit counts with a byte shuffle, and the
+ *          byte counts are summed into four 64-bit lanes with a sum of
+ *          absolute differences against zero
+ */
+__attribute__((target("avx2")))
+static long count_avx2(const uint64_t *a, long n)
+{
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                           1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3,
+                                           1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i sums = _mm256_setzero_si256();
+    long k = 0, total;
+
+    for (; k + 4 <= n; k += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + k));
+        __m256i lo = _mm256_and_si256(x, low);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low);
+        __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, lo),
+                                        _mm256_shuffle_epi8(table, hi));
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(bytes,
+                                          _mm256_setzero_si256()));
+    }
+    total = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+            + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+    for (; k < n; k++) total += popcount64(a[k]);
+    return total;
+}
+
+/* Purpose: equal_avx2 is the AVX2 Bitvec_equal; it compares 32 bytes at a
+ *          time and stops at the first block that differs
+ */
+__attribute__((target("avx2")))
+static int equal_avx2(const uint64_t *a, const uint64_t *b, long n)
+{
+    long k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + k));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + k));
+        __m256i diff = _mm256_xor_si256(x, y);
+        if (!_mm256_testz_si256(diff, diff)) return 0;
+    }
+    for (; k < n; k++)
+        if (a[k] != b[k]) return 0;
+    return 1;
+}
+
+#endif /* BITVEC_X86 */
+
+/* Purpose: choose fills in selected with the fastest kernels the processor
+ *          supports, no faster than BITVEC_KERNELS allows. It runs once,
+ *          through pthread_once
+ * I: N/A
+ * O: N/A
+ */
+static void choose(void)
+{
+    const char *limit = getenv("BITVEC_KERNELS");
+    selected = scalar;
+    if (limit != NULL && strcmp(limit, "scalar") == 0) return;
+
+#ifdef BITVEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")
+        && (limit == NULL || strcmp(limit, "sse2") != 0)) {
+        struct kernels avx2 = { "avx2", and_avx2, or_avx2, xor_avx2,
+                                not_avx2, count_avx2, equal_avx2 };
+        selected = avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        struct kernels sse2 = { "sse2", and_sse2, or_sse2, xor_sse2,
+                                not_sse2, count_scalar, equal_sse2 };
+        if (__builtin_cpu_supports("popcnt")) sse2.count = count_popcnt;
+        selected = sse2;
+    }
+#endif
+}
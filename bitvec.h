@@ -0,0 +1,65 @@
+/*
+ *      bitvec.h
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code declares the bulk kernels Bit2 uses on runs of 64-bit
+ *      words: boolean operations, population count, and comparison. Each
+ *      one has an AVX2 version, an SSE2 version, and a portable scalar
+ *      version, and the fastest one the processor supports is picked the
+ *      first time any kernel is called. Setting the environment variable
+ *      BITVEC_KERNELS to "scalar" or "sse2" before that limits the choice,
+ *      so the fallbacks can be tested and timed on any machine
+ */
+
+#ifndef BITVEC_INCLUDED
+#define BITVEC_INCLUDED
+#include <stdint.h>
+
+/* exported functions */
+
+/* Purpose: Bitvec_and stores a[k] & b[k] in dst[k] for every k < n
+ * I: The destination and two sources of n words each; dst may be a or b
+ * O: N/A
+ */
+void Bitvec_and(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n);
+
+/* Purpose: Bitvec_or stores a[k] | b[k] in dst[k] for every k < n
+ * I: The destination and two sources of n words each; dst may be a or b
+ * O: N/A
+ */
+void Bitvec_or(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n);
+
+/* Purpose: Bitvec_xor stores a[k] ^ b[k] in dst[k] for every k < n
+ * I: The destination and two sources of n words each; dst may be a or b
+ * O: N/A
+ */
+void Bitvec_xor(uint64_t *dst, const uint64_t *a, const uint64_t *b, long n);
+
+/* Purpose: Bitvec_not stores ~a[k] in dst[k] for every k < n
+ * I: The destination and source of n words each; dst may be a
+ * O: N/A
+ */
+void Bitvec_not(uint64_t *dst, const uint64_t *a, long n);
+
+/* Purpose: Bitvec_count counts the set bits in n words
+ * I: The words and how many there are
+ * O: The number of 1 bits
+ */
+long Bitvec_count(const uint64_t *a, long n);
+
+/* Purpose: Bitvec_equal compares n words, stopping at the first difference
+ * I: Two runs of n words
+ * O: 1 if every word is the same, 0 otherwise
+ */
+int Bitvec_equal(const uint64_t *a, const uint64_t *b, long n);
+
+/* Purpose: Bitvec_kernels names the set of kernels in use, choosing them if
+ *          no kernel has been called yet
+ * I: N/A
+ * O: "avx2", "sse2", or "scalar"
+ */
+const char *Bitvec_kernels(void);
+
+#endif
@@ -0,0 +1,746 @@
+/*
+ *      label.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This includes the function definitions for all of the functions
+ *      declared in label.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "label.h"
+#include "pool.h"
+#include "pbm.h"
+#include "assert.h"
+
+/* bands of rows handed out per thread, so a slow band does not hold up the
+ * others
+ */
+#define LABEL_BANDS_PER_THREAD 4
+
+/* records of the log Label_unblack_stream keeps of its first pass, each a
+ * uint64_t with the kind in its top two bits and a slot in its low 31; a
+ * join also holds the slot joined to in the 31 bits above that
+ */
+#define LABEL_NEW 0                 /* a slot was handed out */
+#define LABEL_JOIN 1                /* a root was linked under another */
+#define LABEL_BORDER 2              /* a border component ended */
+#define LABEL_SLOT_MASK 0x7fffffffULL
+
+/* records of the log and bytes of answers buffered at a time */
+#define LABEL_LOG_RECORDS 8192
+#define LABEL_BITS_BYTES 65536
+
+/* a run of black pixels from x0 to x1 (inclusive) in one row */
+struct run {
+    int x0;
+    int x1;
+};
+
+/* struct passed to every band task through Pool_run, describing one
+ * labeling. The runs of row j are runs[row_start[j]] up to (not including)
+ * runs[row_start[j + 1]], and parent holds the union-find forest over run
+ * numbers, in which a root is its own parent and every link goes from a
+ * larger run number to a smaller one
+ */
+struct label_job {
+    Bit2_T image;
+    int nbands;
+    int *row_start;             /* height + 1 entries */
+    struct run *runs;
+    int *parent;
+    unsigned char *border;      /* 1 for the roots of border components */
+};
+
+/* struct for Label_unblack_stream, which labels an image a row at a time.
+ * The runs and labels of the row before the current one and of the current
+ * one take turns in runs[] and labels[].
+ *
+ * In the first pass a label is a slot. A run with no labeled run above it
+ * takes a free slot, slots are joined in parent as runs meet, and border
+ * is set at the root of every slot on the border. At the end of each row
+ * the slots no run of the row refers to are freed, so the two rows never
+ * use more than width + 1 of them. Every slot handed out, every join, and
+ * every border component that ends is written to log, which is then read
+ * backwards to learn, for each slot in the order they were handed out,
+ * whether its component reached the border, one bit each in bits.
+ *
+ * In the second pass a label is that bit: a run takes the bit of the first
+ * run above it that it touches, or the next bit of bits if there is none
+ */
+struct stream {
+    Pbm_T in;
+    int nwords;
+    uint64_t *words;            /* the current row */
+    struct run *runs[2];
+    int *labels[2];
+    int nruns[2];
+    int cur;                    /* which of runs and labels is current */
+    int *parent;                /* width + 1 slots */
+    unsigned char *border;
+    int *seen;                  /* the last row each root was used in */
+    int *live;                  /* the slots in use, nlive of them */
+    int nlive;
+    int *free_slots;            /* the slots not in use, nfree of them */
+    int nfree;
+    FILE *log;
+    uint64_t *log_buf;          /* records not yet written to log */
+    int nlog_buf;
+    long nlog;                  /* records in log, written or not */
+    FILE *bits;
+    long nnew;                  /* slots handed out in the first pass */
+    long nread;                 /* bits read back in the second pass */
+    int bit_byte;               /* the byte of bits being read */
+    int failed;                 /* 1 once log or bits could not be used */
+    int first_pass;             /* 1 while labels are still being joined */
+};
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+static int band_row(struct label_job *job, int k);
+static void count_band(int k, void *cl);
+static void label_band(int k, void *cl);
+static void join_edge(int k, void *cl);
+static void mark_band(int k, void *cl);
+static void clear_band(int k, void *cl);
+static int row_runs(const uint64_t *words, int nwords, struct run *out);
+static void join_rows(struct label_job *job, int above, int below);
+static int find(int *parent, int x);
+static void unite(int *parent, int a, int b);
+static inline int ctz64(uint64_t word);
+static int stream_row(struct stream *st, int j);
+static const uint64_t *stream_out_row(int j, void *cl);
+static void merge(struct stream *st, int a, int b);
+static int new_slot(struct stream *st);
+static void end_row(struct stream *st, int j);
+static void log_record(struct stream *st, uint64_t record);
+static int resolve_bits(struct stream *st);
+static void write_bits(struct stream *st, const unsigned char *bytes,
+                       long lo, long hi);
+static int next_bit(struct stream *st);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose: Label_unblack_edges changes every black pixel connected to the
+ *          border of an image to white, by labeling the black components
+ *          and clearing those with a pixel on the border. The result is the
+ *          same as that of any serial flood fill from the border
+ * I: An existing and initialized Bit2_T object representing an image, and
+ *    the number of threads to use, or a value <= 0 for one per online
+ *    processor
+ * O: N/A
+ */
+void Label_unblack_edges(Bit2_T image, int nthreads)
+{
+    assert(image);
+    int height = Bit2_height(image);
+    struct label_job job;
+    Pool_T pool;
+    int j;
+
+    if (nthreads <= 0) nthreads = Pool_ncpus();
+    job.image = image;
+    job.nbands = nthreads * LABEL_BANDS_PER_THREAD;
+    if (job.nbands > height) job.nbands = height;
+    if (job.nbands < 1) return;
+    pool = Pool_shared(nthreads);
+
+    /* count the runs of every row, then turn the counts into where each
+     * row's runs start
+     */
+    job.row_start = (int *)malloc(((size_t)height + 1) * sizeof(int));
+    assert(job.row_start);
+    job.row_start[0] = 0;
+    Pool_run(pool, job.nbands, count_band, &job);
+    for (j = 0; j < height; j++) job.row_start[j + 1] += job.row_start[j];
+
+    int nruns = job.row_start[height];
+    job.runs = (struct run *)malloc(((size_t)nruns + 1) * sizeof(struct run));
+    job.parent = (int *)malloc(((size_t)nruns + 1) * sizeof(int));
+    job.border = (unsigned char *)calloc((size_t)nruns + 1, 1);
+    assert(job.runs && job.parent && job.border);
+
+    /* each band labels its own runs, the bands are joined where they meet,
+     * the components on the border are marked at their roots, and then
+     * their runs are cleared; every step waits for the one before it
+     */
+    Pool_run(pool, job.nbands, label_band, &job);
+    Pool_run(pool, job.nbands - 1, join_edge, &job);
+    Pool_run(pool, job.nbands, mark_band, &job);
+    Pool_run(pool, job.nbands, clear_band, &job);
+
+    free(job.row_start);
+    free(job.runs);
+    free(job.parent);
+    free(job.border);
+}
+
+/* Purpose: Label_unblack_stream writes an image read from a PBM reader
+ *          with every black pixel connected to its border changed to white,
+ *          without holding the image in memory. The first pass reads the
+ *          rows in order, labeling each run of black pixels from the runs
+ *          it touches in the row above and joining labels that meet, and
+ *          notes which labels reach the border. Only the labels of the last
+ *          two rows are kept, and what happened to them is logged to a
+ *          temporary file; reading that log backwards gives one bit for
+ *          each run that started a label, set if its component reached the
+ *          border, kept in a second temporary file. The second pass rewinds
+ *          the reader, and gives each run the bit of the run above it, or
+ *          the next bit if it starts a label, clearing the runs whose bit
+ *          is set. Memory is O(width); the files grow with the runs that
+ *          start a label and with the joins, eight bytes each
+ * I: A Pbm_T reader at the first row of an image in a file that can seek,
+ *    a file open for writing, and 1 to write P4 or 0 to write P1
+ * O: 0 on success, -1 if the image could not be read twice, a temporary
+ *    file could not be used, or the output could not be written
+ */
+int Label_unblack_stream(Pbm_T in, FILE *out, int raw)
+{
+    assert(in && out);
+    int width = Pbm_width(in), height = Pbm_height(in);
+    int maxruns = width / 2 + 1, j, k, result = -1;
+    size_t nslots = (size_t)width + 1;
+    struct stream st;
+
+    st.in = in;
+    st.nwords = (width + 63) / 64;
+    st.words = (uint64_t *)malloc(st.nwords * sizeof(uint64_t));
+    st.runs[0] = (struct run *)malloc(maxruns * sizeof(struct run));
+    st.runs[1] = (struct run *)malloc(maxruns * sizeof(struct run));
+    st.labels[0] = (int *)malloc(maxruns * sizeof(int));
+    st.labels[1] = (int *)malloc(maxruns * sizeof(int));
+    st.parent = (int *)malloc(nslots * sizeof(int));
+    st.border = (unsigned char *)malloc(nslots);
+    st.seen = (int *)malloc(nslots * sizeof(int));
+    st.live = (int *)malloc(nslots * sizeof(int));
+    st.free_slots = (int *)malloc(nslots * sizeof(int));
+    st.log_buf = (uint64_t *)malloc(LABEL_LOG_RECORDS * sizeof(uint64_t));
+    assert(st.words && st.runs[0] && st.runs[1] && st.labels[0]
+           && st.labels[1] && st.parent && st.border && st.seen && st.live
+           && st.free_slots && st.log_buf);
+
+    /* slots are handed out lowest first */
+    for (k = 0; k <= width; k++) {
+        st.seen[k] = -1;
+        st.free_slots[k] = width - k;
+    }
+    st.nfree = width + 1;
+    st.nlive = 0;
+    st.nlog_buf = 0;
+    st.nlog = st.nnew = st.nread = 0;
+    st.failed = 0;
+    st.log = tmpfile();
+    st.bits = tmpfile();
+
+    /* the first pass joins labels; the second reads back, in the same
+     * order, whether each new label reached the border
+     */
+    st.first_pass = 1;
+    st.cur = 0;
+    st.nruns[0] = st.nruns[1] = 0;
+    for (j = 0; st.log && st.bits && j < height; j++)
+        if (!stream_row(&st, j)) break;
+
+    if (j == height) {
+        /* no run refers to any slot after the last row */
+        st.nruns[st.cur] = 0;
+        end_row(&st, height);
+    }
+    if (j == height && resolve_bits(&st) == 0 && Pbm_rewind(in) == 0) {
+        st.first_pass = 0;
+        st.nruns[0] = st.nruns[1] = 0;
+        result = Pbm_write_rows(out, width, height, raw, stream_out_row,
+                                &st);
+        if (st.failed) result = -1;
+    }
+
+    if (st.log) fclose(st.log);
+    if (st.bits) fclose(st.bits);
+    free(st.words);
+    free(st.runs[0]);
+    free(st.runs[1]);
+    free(st.labels[0]);
+    free(st.labels[1]);
+    free(st.parent);
+    free(st.border);
+    free(st.seen);
+    free(st.live);
+    free(st.free_slots);
+    free(st.log_buf);
+    return result;
+}
+
+/* Purpose: band_row returns the first row of a band; the rows are split as
+ *          evenly as they can be
+ * I: A pointer to the labeling job and a band number, from 0 to nbands
+ * O: The first row of band k, or the height for k == nbands
+ */
+static int band_row(struct label_job *job, int k)
+{
+    return (int)((long)k * Bit2_height(job->image) / job->nbands);
+}
+
+/* Purpose: count_band counts the runs in every row of one band, storing the
+ *          count for row j in row_start[j + 1]
+ * I: The band number and a void pointer to the labeling job
+ * O: N/A
+ */
+static void count_band(int k, void *cl)
+{
+    struct label_job *job = cl;
+    int nwords = Bit2_words_per_row(job->image);
+    int j;
+    for (j = band_row(job, k); j < band_row(job, k + 1); j++)
+        job->row_start[j + 1] =
+            row_runs(Bit2_row_words(job->image, j, NULL), nwords, NULL);
+}
+
+/* Purpose: label_band finds the runs of one band and unites every run with
+ *          the runs it touches in the row above, within the band. A band
+ *          only writes the entries of its own runs, so the bands do not
+ *          get in each other's way
+ * I: The band number and a void pointer to the labeling job
+ * O: N/A
+ */
+static void label_band(int k, void *cl)
+{
+    struct label_job *job = cl;
+    int nwords = Bit2_words_per_row(job->image);
+    int first = band_row(job, k), end = band_row(job, k + 1), j, r;
+    for (j = first; j < end; j++) {
+        row_runs(Bit2_row_words(job->image, j, NULL), nwords,
+                 job->runs + job->row_start[j]);
+        for (r = job->row_start[j]; r < job->row_start[j + 1]; r++)
+            job->parent[r] = r;
+        if (j > first) join_rows(job, j - 1, j);
+    }
+}
+
+/* Purpose: join_edge unites the runs of the first row of band k + 1 with
+ *          those of the last row of band k. The edges are joined at the
+ *          same time, which the atomic unite allows
+ * I: The edge number, from 0 to nbands - 2, and a void pointer to the
+ *    labeling job
+ * O: N/A
+ */
+static void join_edge(int k, void *cl)
+{
+    struct label_job *job = cl;
+    int j = band_row(job, k + 1);
+    join_rows(job, j - 1, j);
+}
+
+/* Purpose: mark_band marks the root of every run of one band that has a
+ *          pixel on the border of the image
+ * I: The band number and a void pointer to the labeling job
+ * O: N/A
+ */
+static void mark_band(int k, void *cl)
+{
+    struct label_job *job = cl;
+    int width = Bit2_width(job->image), height = Bit2_height(job->image);
+    int j, r;
+    for (j = band_row(job, k); j < band_row(job, k + 1); j++) {
+        for (r = job->row_start[j]; r < job->row_start[j + 1]; r++) {
+            if (j == 0 || j == height - 1 || job->runs[r].x0 == 0
+                || job->runs[r].x1 == width - 1)
+                __atomic_store_n(&job->border[find(job->parent, r)], 1,
+                                 __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* Purpose: clear_band turns white every run of one band whose component was
+ *          marked, a word at a time
+ * I: The band number and a void pointer to the labeling job
+ * O: N/A
+ */
+static void clear_band(int k, void *cl)
+{
+    struct label_job *job = cl;
+    int j, r, w;
+    for (j = band_row(job, k); j < band_row(job, k + 1); j++) {
+        uint64_t *row = Bit2_row_words(job->image, j, NULL);
+        for (r = job->row_start[j]; r < job->row_start[j + 1]; r++) {
+            if (job->border[find(job->parent, r)] == 0) continue;
+            int first = job->runs[r].x0 / 64, last = job->runs[r].x1 / 64;
+            for (w = first; w <= last; w++) {
+                uint64_t mask = ~0ULL;
+                if (w == first) mask &= ~0ULL << (job->runs[r].x0 % 64);
+                if (w == last) mask &= ~0ULL >> (63 - job->runs[r].x1 % 64);
+                row[w] &= ~mask;
+            }
+        }
+    }
+}
+
+/* Purpose: row_runs finds the runs of black pixels in a row, left to right.
+ *          A run starts at a black pixel whose left neighbor is white and
+ *          ends at one whose right neighbor is white; both kinds of pixel
+ *          are found a word at a time with shifts and taken out with ctz64
+ * I: The words of a row, how many there are, and room for the runs, or
+ *    NULL to only count them
+ * O: The number of runs
+ */
+static int row_runs(const uint64_t *words, int nwords, struct run *out)
+{
+    int n = 0, k;
+    uint64_t carry = 0;     /* whether the pixel left of the word is black */
+    for (k = 0; k < nwords; k++) {
+        uint64_t word = words[k];
+        uint64_t next = k + 1 < nwords ? words[k + 1] & 1 : 0;
+        uint64_t starts = word & ~((word << 1) | carry);
+        carry = word >> 63;
+        if (out == NULL) {
+            n += __builtin_popcountll(starts);
+            continue;
+        }
+
+        /* starts and ends alternate, and a one-pixel run has both */
+        uint64_t ends = word & ~((word >> 1) | (next << 63));
+        while (starts != 0 || ends != 0) {
+            if (starts != 0 && (ends == 0 || ctz64(starts) <= ctz64(ends))) {
+                out[n].x0 = 64 * k + ctz64(starts);
+                starts &= starts - 1;
+            } else {
+                out[n++].x1 = 64 * k + ctz64(ends);
+                ends &= ends - 1;
+            }
+        }
+    }
+    return n;
+}
+
+/* Purpose: join_rows unites every run of a row with the runs of the row
+ *          above that it touches, walking the two rows' runs in step
+ * I: A pointer to the labeling job and two neighboring rows, both labeled
+ * O: N/A
+ */
+static void join_rows(struct label_job *job, int above, int below)
+{
+    int a = job->row_start[above], a_end = job->row_start[above + 1];
+    int b = job->row_start[below], b_end = job->row_start[below + 1];
+    const struct run *runs = job->runs;
+    while (a < a_end && b < b_end) {
+        if (runs[a].x0 <= runs[b].x1 && runs[b].x0 <= runs[a].x1)
+            unite(job->parent, a, b);
+        if (runs[a].x1 < runs[b].x1) a++;
+        else b++;
+    }
+}
+
+/* Purpose: find returns the root of a run's component, halving the path on
+ *          the way. Every entry it writes is an ancestor of the run, so
+ *          finds and unites may run at the same time
+ * I: The union-find forest and a run number
+ * O: The run number of the root
+ */
+static int find(int *parent, int x)
+{
+    int p = __atomic_load_n(&parent[x], __ATOMIC_RELAXED);
+    while (p != x) {
+        int grand = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+        if (grand != p) __atomic_store_n(&parent[x], grand, __ATOMIC_RELAXED);
+        x = grand;
+        p = __atomic_load_n(&parent[x], __ATOMIC_RELAXED);
+    }
+    return x;
+}
+
+/* Purpose: unite joins the components of two runs, linking the root with the
+ *          larger run number under the other with a compare-and-swap, and
+ *          trying again if another thread changed that root first
+ * I: The union-find forest and two run numbers
+ * O: N/A
+ */
+static void unite(int *parent, int a, int b)
+{
+    for (;;) {
+        a = find(parent, a);
+        b = find(parent, b);
+        if (a == b) return;
+        if (a < b) {
+            int t = a;
+            a = b;
+            b = t;
+        }
+        int expected = a;
+        if (__atomic_compare_exchange_n(&parent[a], &expected, b, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            return;
+    }
+}
+
+/* Purpose: stream_row reads the next row of a streamed image and labels
+ *          its runs. A run takes the label of the first run above it that
+ *          it touches. If there is none, it takes a new slot in the first
+ *          pass and the next bit in the second. In the first pass the
+ *          labels of any other runs above it that it touches are joined to
+ *          it, a run on the border marks its label's root, and the slots
+ *          the row no longer uses are freed
+ * I: A pointer to the stream and the number of the row, which must be the
+ *    row after the one before
+ * O: 1 if the row was read, 0 if it could not be
+ */
+static int stream_row(struct stream *st, int j)
+{
+    int width = Pbm_width(st->in), height = Pbm_height(st->in);
+    if (!Pbm_read_row(st->in, st->words)) return 0;
+
+    st->cur = !st->cur;
+    const struct run *above = st->runs[!st->cur], *runs = st->runs[st->cur];
+    const int *above_labels = st->labels[!st->cur];
+    int *labels = st->labels[st->cur];
+    int nabove = st->nruns[!st->cur], n, r, a = 0, q;
+    n = st->nruns[st->cur] = row_runs(st->words, st->nwords,
+                                      st->runs[st->cur]);
+
+    for (r = 0; r < n; r++) {
+        int label = -1;
+
+        /* runs above that end left of this one touch no later run either */
+        while (a < nabove && above[a].x1 < runs[r].x0) a++;
+        for (q = a; q < nabove && above[q].x0 <= runs[r].x1; q++) {
+            if (label < 0) label = above_labels[q];
+            else if (st->first_pass) merge(st, label, above_labels[q]);
+            else break;
+        }
+
+        if (label < 0)
+            label = st->first_pass ? new_slot(st) : next_bit(st);
+        labels[r] = label;
+
+        if (st->first_pass && (j == 0 || j == height - 1 || runs[r].x0 == 0
+                               || runs[r].x1 == width - 1))
+            st->border[find(st->parent, label)] = 1;
+    }
+
+    if (st->first_pass) end_row(st, j);
+    return 1;
+}
+
+/* Purpose: stream_out_row hands Pbm_write_rows the next row of the second
+ *          pass, with the runs whose components reached the border cleared
+ * I: The number of the row and a void pointer to the stream
+ * O: The words of the row, or NULL if it or its bits could not be read
+ */
+static const uint64_t *stream_out_row(int j, void *cl)
+{
+    struct stream *st = cl;
+    int r, w;
+    if (!stream_row(st, j) || st->failed) return NULL;
+
+    const struct run *runs = st->runs[st->cur];
+    for (r = 0; r < st->nruns[st->cur]; r++) {
+        if (st->labels[st->cur][r] == 0) continue;
+        int first = runs[r].x0 / 64, last = runs[r].x1 / 64;
+        for (w = first; w <= last; w++) {
+            uint64_t mask = ~0ULL;
+            if (w == first) mask &= ~0ULL << (runs[r].x0 % 64);
+            if (w == last) mask &= ~0ULL >> (63 - runs[r].x1 % 64);
+            st->words[w] &= ~mask;
+        }
+    }
+    return st->words;
+}
+
+/* Purpose: merge joins two slots of a stream's first pass, linking the root
+ *          with the larger number under the other, carrying its border mark
+ *          over, and logging the join
+ * I: A pointer to the stream and two slots in use
+ * O: N/A
+ */
+static void merge(struct stream *st, int a, int b)
+{
+    a = find(st->parent, a);
+    b = find(st->parent, b);
+    if (a == b) return;
+    if (a < b) {
+        int t = a;
+        a = b;
+        b = t;
+    }
+    st->parent[a] = b;
+    st->border[b] |= st->border[a];
+    log_record(st, (uint64_t)LABEL_JOIN << 62 | (uint64_t)b << 31
+                   | (uint64_t)a);
+}
+
+/* Purpose: new_slot hands out a free slot as the root of a new component
+ *          and logs it. The slots in use are the roots the row above left
+ *          and the slots started in this row, at most one per run of either
+ *          row, so there is always one free
+ * I: A pointer to the stream, in its first pass
+ * O: The slot
+ */
+static int new_slot(struct stream *st)
+{
+    assert(st->nfree > 0);
+    int slot = st->free_slots[--st->nfree];
+    st->parent[slot] = slot;
+    st->border[slot] = 0;
+    st->live[st->nlive++] = slot;
+    st->nnew++;
+    log_record(st, (uint64_t)LABEL_NEW << 62 | (uint64_t)slot);
+    return slot;
+}
+
+/* Purpose: end_row points the labels of the current row at their roots and
+ *          frees every slot in use that is not one of those roots: slots
+ *          joined under another, and roots of components that have ended.
+ *          An ended component that reached the border is logged
+ * I: A pointer to the stream, in its first pass, and the number of the row
+ *    just labeled
+ * O: N/A
+ */
+static void end_row(struct stream *st, int j)
+{
+    int *labels = st->labels[st->cur], r, k, kept = 0;
+    for (r = 0; r < st->nruns[st->cur]; r++) {
+        labels[r] = find(st->parent, labels[r]);
+        st->seen[labels[r]] = j;
+    }
+
+    for (k = 0; k < st->nlive; k++) {
+        int slot = st->live[k];
+        if (st->parent[slot] == slot && st->seen[slot] == j) {
+            st->live[kept++] = slot;
+            continue;
+        }
+        if (st->parent[slot] == slot && st->border[slot])
+            log_record(st, (uint64_t)LABEL_BORDER << 62 | (uint64_t)slot);
+        st->free_slots[st->nfree++] = slot;
+    }
+    st->nlive = kept;
+}
+
+/* Purpose: log_record adds a record to the log of a stream's first pass,
+ *          writing the buffered records out when the buffer is full
+ * I: A pointer to the stream and the record
+ * O: N/A; failed is set if the log could not be written
+ */
+static void log_record(struct stream *st, uint64_t record)
+{
+    if (st->nlog_buf == LABEL_LOG_RECORDS) {
+        if (fwrite(st->log_buf, sizeof(uint64_t), st->nlog_buf, st->log)
+            != (size_t)st->nlog_buf)
+            st->failed = 1;
+        st->nlog_buf = 0;
+    }
+    st->log_buf[st->nlog_buf++] = record;
+    st->nlog++;
+}
+
+/* Purpose: resolve_bits reads the log of the first pass backwards, keeping
+ *          for each slot whether the component it is part of at that point
+ *          will reach the border: set when a border component ends, copied
+ *          from the root a slot was joined under, and written out as the
+ *          slot's bit, then cleared for the slot's earlier use, where the
+ *          slot was handed out. The bits come out last first, so they are
+ *          gathered in a buffer filled from its end and written at their
+ *          place in the file
+ * I: A pointer to the stream, after its first pass
+ * O: 0 with bits ready to be read from its start, or -1 if a temporary file
+ *    could not be used
+ */
+static int resolve_bits(struct stream *st)
+{
+    int width = Pbm_width(st->in), n, i;
+    unsigned char *answer = (unsigned char *)calloc((size_t)width + 1, 1);
+    unsigned char *bytes = (unsigned char *)malloc(LABEL_BITS_BYTES);
+    assert(answer && bytes);
+    long end = st->nlog, nnew = st->nnew, hi = (nnew + 7) / 8;
+    long lo = hi > LABEL_BITS_BYTES ? hi - LABEL_BITS_BYTES : 0;
+    memset(bytes, 0, LABEL_BITS_BYTES);
+
+    /* the records still buffered are the last ones, and are read first */
+    if (fwrite(st->log_buf, sizeof(uint64_t), st->nlog_buf, st->log)
+        != (size_t)st->nlog_buf)
+        st->failed = 1;
+
+    while (!st->failed && end > 0) {
+        n = end > LABEL_LOG_RECORDS ? LABEL_LOG_RECORDS : (int)end;
+        end -= n;
+        if (fseek(st->log, end * (long)sizeof(uint64_t), SEEK_SET) != 0
+            || fread(st->log_buf, sizeof(uint64_t), n, st->log)
+               != (size_t)n) {
+            st->failed = 1;
+            break;
+        }
+
+        for (i = n - 1; i >= 0; i--) {
+            uint64_t record = st->log_buf[i];
+            int slot = (int)(record & LABEL_SLOT_MASK);
+            switch (record >> 62) {
+            case LABEL_NEW:
+                nnew--;
+                if (nnew / 8 < lo) {
+                    write_bits(st, bytes, lo, hi);
+                    hi = lo;
+                    lo = hi > LABEL_BITS_BYTES ? hi - LABEL_BITS_BYTES : 0;
+                    memset(bytes, 0, LABEL_BITS_BYTES);
+                }
+                if (answer[slot])
+                    bytes[nnew / 8 - lo] |= (unsigned char)(1 << nnew % 8);
+                answer[slot] = 0;
+                break;
+            case LABEL_JOIN:
+                answer[slot] = answer[(record >> 31) & LABEL_SLOT_MASK];
+                break;
+            case LABEL_BORDER:
+                answer[slot] = 1;
+                break;
+            }
+        }
+    }
+    write_bits(st, bytes, lo, hi);
+    if (fseek(st->bits, 0, SEEK_SET) != 0) st->failed = 1;
+
+    free(answer);
+    free(bytes);
+    return st->failed ? -1 : 0;
+}
+
+/* Purpose: write_bits writes a buffer of bits to its place in the bits file
+ * I: A pointer to the stream, the buffer, and the first and one past the
+ *    last byte of the file it holds
+ * O: N/A; failed is set if the bits could not be written
+ */
+static void write_bits(struct stream *st, const unsigned char *bytes,
+                       long lo, long hi)
+{
+    if (st->failed || hi == lo) return;
+    if (fseek(st->bits, lo, SEEK_SET) != 0
+        || fwrite(bytes, 1, hi - lo, st->bits) != (size_t)(hi - lo))
+        st->failed = 1;
+}
+
+/* Purpose: next_bit reads the bit of the next run that starts a label in
+ *          the second pass
+ * I: A pointer to the stream, in its second pass
+ * O: 1 if the run's component reaches the border, 0 if not; failed is set
+ *    if the bit could not be read
+ */
+static int next_bit(struct stream *st)
+{
+    if (st->nread % 8 == 0) {
+        st->bit_byte = getc(st->bits);
+        if (st->bit_byte == EOF) {
+            st->failed = 1;
+            st->bit_byte = 0;
+        }
+    }
+    return st->bit_byte >> (st->nread++ % 8) & 1;
+}
+
+/* Purpose: ctz64 counts the 0 bits below the lowest 1 bit of a word. The
+ *          union-find already needs GCC's atomic builtins, so this uses
+ *          GCC's builtin too
+ * I: A nonzero word
+ * O: The index of its lowest 1 bit
+ */
+static inline int ctz64(uint64_t word)
+{
+    return __builtin_ctzll(word);
+}
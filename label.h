@@ -0,0 +1,58 @@
+/*
+ *      label.h
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code declares the functions that label the black components of
+ *      a Bit2_T (pixels joined through their left, right, top, and bottom
+ *      neighbors, as in unblackedges) with a union-find over runs of black
+ *      pixels. The image is cut into bands of rows, which are labeled at
+ *      the same time on the shared Pool_T, and the bands are then joined
+ *      along their edges through an atomic union-find. For images too big
+ *      to hold, Label_unblack_stream labels a PBM file a row at a time in
+ *      two passes, with memory that grows with the width rather than with
+ *      the rows
+ */
+
+#ifndef LABEL_INCLUDED
+#define LABEL_INCLUDED
+#include <stdio.h>
+#include "bit2.h"
+#include "pbm.h"
+
+/* exported functions */
+
+/* Purpose: Label_unblack_edges changes every black pixel connected to the
+ *          border of an image to white, by labeling the black components
+ *          and clearing those with a pixel on the border. The result is the
+ *          same as that of any serial flood fill from the border
+ * I: An existing and initialized Bit2_T object representing an image, and
+ *    the number of threads to use, or a value <= 0 for one per online
+ *    processor
+ * O: N/A
+ */
+void Label_unblack_edges(Bit2_T image, int nthreads);
+
+/* Purpose: Label_unblack_stream writes an image read from a PBM reader
+ *          with every black pixel connected to its border changed to white,
+ *          without holding the image in memory. The first pass reads the
+ *          rows in order, labeling each run of black pixels from the runs
+ *          it touches in the row above and joining labels that meet, and
+ *          notes which labels reach the border. Only the labels of the last
+ *          two rows are kept, and what happened to them is logged to a
+ *          temporary file; reading that log backwards gives one bit for
+ *          each run that started a label, set if its component reached the
+ *          border, kept in a second temporary file. The second pass rewinds
+ *          the reader, and gives each run the bit of the run above it, or
+ *          the next bit if it starts a label, clearing the runs whose bit
+ *          is set. Memory is O(width); the files grow with the runs that
+ *          start a label and with the joins, eight bytes each
+ * I: A Pbm_T reader at the first row of an image in a file that can seek,
+ *    a file open for writing, and 1 to write P4 or 0 to write P1
+ * O: 0 on success, -1 if the image could not be read twice, a temporary
+ *    file could not be used, or the output could not be written
+ */
+int Label_unblack_stream(Pbm_T in, FILE *out, int raw);
+
+#endif
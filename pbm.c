@@ -0,0 +1,544 @@
+/*
+ *      pbm.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code includes the function definitions for all the functions
+ *      declared in pbm.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pbm.h"
+#include "assert.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define PBM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* size of the input buffer, and the least size of the output buffer */
+#define PBM_BUFSIZE (1 << 20)
+
+/* A Pbm_T reads its file PBM_BUFSIZE bytes at a time into buf; the bytes
+ * [pos, len) have not been used yet
+ */
+struct Pbm_T {
+    FILE *fp;
+    int width;
+    int height;
+    int raw;                /* 1 for P4, 0 for P1 */
+    int row;                /* next row to be read */
+    unsigned char *buf;
+    size_t pos;
+    size_t len;
+    long bytes;             /* bytes read from fp so far */
+    int eof;                /* fread has come up empty */
+    long data;              /* file offset of the first row, -1 if unknown */
+};
+
+/* reverse[b] is byte b with its bits in the opposite order; P4 puts the
+ * leftmost pixel in the high bit of a byte and Bit2 in the low bit
+ */
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+static const unsigned char reverse[256] = { R6(0), R6(2), R6(1), R6(3) };
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+static size_t fill(Pbm_T pbm, size_t want);
+static int next_byte(Pbm_T pbm);
+static int read_header_int(Pbm_T pbm);
+static int read_plain_row(Pbm_T pbm, uint64_t *words);
+static int read_raw_row(Pbm_T pbm, uint64_t *words);
+static int is_space(int c);
+static inline uint64_t reverse_bytes(uint64_t word);
+static size_t format_plain_row(const uint64_t *words, int width,
+                               const char (*table)[16], char *out);
+static size_t format_raw_row(const uint64_t *words, int width,
+                             unsigned char *out);
+static const uint64_t *bit2_row(int j, void *cl);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose: Pbm_open reads the header of a PBM image from a file and returns
+ *          a reader positioned at its first row. The reader keeps its own
+ *          large input buffer, so it may read past the image in the file
+ * I: A file open for reading
+ * O: A Pbm_T object, or NULL if the file does not start with a P1 or P4
+ *    header with a positive width and height (nothing is allocated then)
+ */
+Pbm_T Pbm_open(FILE *fp)
+{
+    assert(fp);
+    Pbm_T pbm = (Pbm_T)malloc(sizeof(*pbm));
+    assert(pbm);
+    pbm->buf = (unsigned char *)malloc(PBM_BUFSIZE);
+    assert(pbm->buf);
+    pbm->fp = fp;
+    pbm->pos = pbm->len = 0;
+    pbm->bytes = 0;
+    pbm->eof = 0;
+    pbm->row = 0;
+    long start = ftell(fp);
+
+    int magic = next_byte(pbm), kind = next_byte(pbm);
+    pbm->raw = kind == '4';
+    if (magic != 'P' || (kind != '1' && kind != '4')) {
+        Pbm_close(&pbm);
+        return NULL;
+    }
+    pbm->width = read_header_int(pbm);
+    pbm->height = read_header_int(pbm);
+    if (pbm->width <= 0 || pbm->height <= 0) {
+        Pbm_close(&pbm);
+        return NULL;
+    }
+
+    /* read_header_int stops after the one whitespace byte that ends the
+     * height, which is where a P4 raster begins
+     */
+    pbm->data = start < 0 ? -1 : start + pbm->bytes - (long)(pbm->len
+                                                             - pbm->pos);
+    return pbm;
+}
+
+/* Purpose: Pbm_close frees a reader. The file is not closed
+ * I: A nonnull pointer to a Pbm_T object
+ * O: N/A
+ */
+void Pbm_close(Pbm_T *pbm)
+{
+    assert(pbm && *pbm);
+    free((*pbm)->buf);
+    free(*pbm);
+    *pbm = NULL;
+}
+
+/* Purpose: Pbm_width and Pbm_height return the size of the image given in
+ *          the header, and Pbm_raw returns 1 for a P4 image and 0 for P1
+ * I: An existing and initialized Pbm_T object
+ * O: The width, height, or format
+ */
+int Pbm_width(Pbm_T pbm)
+{
+    assert(pbm);
+    return pbm->width;
+}
+
+int Pbm_height(Pbm_T pbm)
+{
+    assert(pbm);
+    return pbm->height;
+}
+
+int Pbm_raw(Pbm_T pbm)
+{
+    assert(pbm);
+    return pbm->raw;
+}
+
+/* Purpose: Pbm_read_row reads the next row of the image into words laid
+ *          out as for Bit2_get_word; bits past the width are set to 0
+ * I: An existing and initialized Pbm_T object with rows left, and room for
+ *    (width + 63) / 64 words
+ * O: 1 if a row was read, 0 if the file ended or held something other than
+ *    pixels where the row should be
+ */
+int Pbm_read_row(Pbm_T pbm, uint64_t *words)
+{
+    assert(pbm && words);
+    assert(pbm->row < pbm->height);
+    int ok = pbm->raw ? read_raw_row(pbm, words)
+                      : read_plain_row(pbm, words);
+    pbm->row++;
+    return ok;
+}
+
+/* Purpose: Pbm_read reads the rest of the image into a new Bit2_T
+ * I: An existing and initialized Pbm_T object
+ * O: A new Bit2_T holding the image (freed with Bit2_free), or NULL if a
+ *    row could not be read
+ */
+Bit2_T Pbm_read(Pbm_T pbm)
+{
+    assert(pbm);
+    Bit2_T bit2 = Bit2_new(pbm->width, pbm->height);
+    while (pbm->row < pbm->height) {
+        if (!Pbm_read_row(pbm, Bit2_row_words(bit2, pbm->row, NULL))) {
+            Bit2_free(&bit2);
+            return NULL;
+        }
+    }
+    return bit2;
+}
+
+/* Purpose: Pbm_bytes returns how many bytes the reader has taken from its
+ *          file so far, for reporting throughput
+ * I: An existing and initialized Pbm_T object
+ * O: The number of bytes read from the file
+ */
+long Pbm_bytes(Pbm_T pbm)
+{
+    assert(pbm);
+    return pbm->bytes;
+}
+
+/* Purpose: Pbm_data_offset returns where the first row of the image starts
+ *          in the file, so the raster of a raw image can be mapped directly
+ * I: An existing and initialized Pbm_T object
+ * O: The file offset of the first row, or -1 if the file cannot tell
+ */
+long Pbm_data_offset(Pbm_T pbm)
+{
+    assert(pbm);
+    return pbm->data;
+}
+
+/* Purpose: Pbm_rewind moves a reader back to the first row of its image,
+ *          so the image can be read again without being held in memory
+ * I: An existing and initialized Pbm_T object
+ * O: 0 on success, -1 if the file cannot seek (a pipe, for instance)
+ */
+int Pbm_rewind(Pbm_T pbm)
+{
+    assert(pbm);
+    if (pbm->data < 0 || fseek(pbm->fp, pbm->data, SEEK_SET) != 0)
+        return -1;
+    pbm->pos = pbm->len = 0;
+    pbm->eof = 0;
+    pbm->row = 0;
+    return 0;
+}
+
+/* Purpose: Pbm_write writes a Bit2_T as a PBM image. P1 output has the
+ *          pixels of a row separated by spaces and ends each row with a
+ *          newline; it is formatted into a large buffer from a table that
+ *          turns each byte of a row's words into 16 characters. P4 output
+ *          packs eight pixels to a byte, leftmost in the high bit. Either
+ *          way the buffer goes out in large fwrite calls
+ * I: A file open for writing, an existing and initialized Bit2_T object,
+ *    and 1 for P4 or 0 for P1
+ * O: 0 on success, -1 if writing failed
+ */
+int Pbm_write(FILE *fp, Bit2_T bit2, int raw)
+{
+    assert(fp && bit2);
+    return Pbm_write_rows(fp, Bit2_width(bit2), Bit2_height(bit2), raw,
+                          bit2_row, bit2);
+}
+
+/* Purpose: Pbm_write_rows writes a PBM image whose rows come one at a time
+ *          from a function, top to bottom, in the same formats and with the
+ *          same buffering as Pbm_write, so an image never has to be whole
+ *          in memory to be written
+ * I: A file open for writing, the width and height, 1 for P4 or 0 for P1,
+ *    a function returning the words of row j (laid out as for
+ *    Bit2_get_word, with 0 past the width) or NULL if it has none, and a
+ *    void pointer passed to it
+ * O: 0 on success, -1 if writing failed or a row could not be had
+ */
+int Pbm_write_rows(FILE *fp, int width, int height, int raw,
+                   const uint64_t *row(int j, void *cl), void *cl)
+{
+    assert(fp && row);
+    assert(width > 0 && height > 0);
+    size_t row_bytes = raw ? (size_t)(width + 7) / 8 + 8
+                           : 2 * (size_t)width + 16;
+    size_t size = row_bytes > PBM_BUFSIZE ? row_bytes : PBM_BUFSIZE;
+    char *buf = (char *)malloc(size);
+    char table[256][16];
+    size_t used = 0;
+    int j, ok = 1;
+    assert(buf);
+
+    /* table[v] is "a b c d e f g h " for the eight pixels of byte v, the
+     * low bit first
+     */
+    if (!raw) {
+        int v, b;
+        for (v = 0; v < 256; v++) {
+            for (b = 0; b < 8; b++) {
+                table[v][2 * b] = '0' + ((v >> b) & 1);
+                table[v][2 * b + 1] = ' ';
+            }
+        }
+    }
+
+    ok = fprintf(fp, "%s\n%d %d\n", raw ? "P4" : "P1", width, height) > 0;
+    for (j = 0; j < height && ok; j++) {
+        if (size - used < row_bytes) {
+            ok = fwrite(buf, 1, used, fp) == used;
+            used = 0;
+        }
+        const uint64_t *words = row(j, cl);
+        if (words == NULL)
+            ok = 0;
+        else if (raw)
+            used += format_raw_row(words, width, (unsigned char *)buf + used);
+        else
+            used += format_plain_row(words, width,
+                                     (const char (*)[16])table, buf + used);
+    }
+    if (ok && used > 0) ok = fwrite(buf, 1, used, fp) == used;
+    free(buf);
+    return ok ? 0 : -1;
+}
+
+/* Purpose: bit2_row hands Pbm_write_rows the rows of a Bit2_T
+ * I: A row number and a void pointer to the Bit2_T
+ * O: The words of the row
+ */
+static const uint64_t *bit2_row(int j, void *cl)
+{
+    return Bit2_row_words(cl, j, NULL);
+}
+
+/* Purpose: fill makes sure at least want unused bytes are in the buffer if
+ *          the file has them, moving the unused bytes to the front and
+ *          reading as much as fits after them
+ * I: An existing and initialized Pbm_T object and a byte count no larger
+ *    than PBM_BUFSIZE
+ * O: The number of unused bytes now in the buffer (less than want only at
+ *    the end of the file)
+ */
+static size_t fill(Pbm_T pbm, size_t want)
+{
+    size_t have = pbm->len - pbm->pos;
+    if (have >= want) return have;
+
+    memmove(pbm->buf, pbm->buf + pbm->pos, have);
+    pbm->pos = 0;
+    pbm->len = have;
+    while (pbm->len < want && !pbm->eof) {
+        size_t got = fread(pbm->buf + pbm->len, 1, PBM_BUFSIZE - pbm->len,
+                           pbm->fp);
+        if (got == 0) pbm->eof = 1;
+        pbm->len += got;
+        pbm->bytes += got;
+    }
+    return pbm->len;
+}
+
+/* Purpose: next_byte returns the next unused byte of the file
+ * I: An existing and initialized Pbm_T object
+ * O: The byte, or EOF at the end of the file
+ */
+static int next_byte(Pbm_T pbm)
+{
+    if (pbm->pos == pbm->len && fill(pbm, 1) == 0) return EOF;
+    return pbm->buf[pbm->pos++];
+}
+
+/* Purpose: is_space tells whether a byte is PBM whitespace
+ * I: A byte or EOF
+ * O: 1 for a space, tab, newline, vertical tab, form feed, or carriage
+ *    return, 0 otherwise
+ */
+static int is_space(int c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/* Purpose: read_header_int reads a decimal number from the header, skipping
+ *          the whitespace and # comments before it, and the one whitespace
+ *          byte after it
+ * I: An existing and initialized Pbm_T object
+ * O: The number, or -1 if there is no number or it is too large
+ */
+static int read_header_int(Pbm_T pbm)
+{
+    int c = next_byte(pbm);
+    long n = 0;
+    for (;;) {
+        if (c == '#')
+            while (c != '\n' && c != EOF) c = next_byte(pbm);
+        else if (is_space(c)) c = next_byte(pbm);
+        else break;
+    }
+    if (c < '0' || c > '9') return -1;
+    while (c >= '0' && c <= '9') {
+        n = n * 10 + (c - '0');
+        if (n > 1000000000) return -1;
+        c = next_byte(pbm);
+    }
+    if (!is_space(c)) return -1;
+    return (int)n;
+}
+
+/* Purpose: read_plain_row reads one P1 row, whose pixels are '0' and '1'
+ *          bytes with optional whitespace between them. Where 16 bytes are
+ *          in the buffer and they are all digits or whitespace, they are
+ *          classified at once with SSE2 compares and the digits are taken
+ *          from the resulting bit masks; anything else, such as a comment,
+ *          goes a byte at a time
+ * I: An existing and initialized Pbm_T object reading a P1 image, and room
+ *    for the row's words
+ * O: 1 if the row was read, 0 otherwise
+ */
+static int read_plain_row(Pbm_T pbm, uint64_t *words)
+{
+    int width = pbm->width, i = 0;
+    uint64_t word = 0;
+
+    while (i < width) {
+#ifdef PBM_SSE2
+        if (pbm->len - pbm->pos >= 16 || fill(pbm, 16) >= 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)
+                                            (pbm->buf + pbm->pos));
+            __m128i ones = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('1'));
+            __m128i digits = _mm_or_si128(ones, _mm_cmpeq_epi8(chunk,
+                                                   _mm_set1_epi8('0')));
+            __m128i spaces = _mm_or_si128(
+                _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')),
+                             _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+            unsigned digit_mask = _mm_movemask_epi8(digits);
+            unsigned one_mask = _mm_movemask_epi8(ones);
+            unsigned used = 16;
+
+            if ((digit_mask | _mm_movemask_epi8(spaces)) == 0xffff) {
+                while (digit_mask != 0) {
+                    int b = __builtin_ctz(digit_mask);
+                    word |= (uint64_t)((one_mask >> b) & 1) << (i % 64);
+                    digit_mask &= digit_mask - 1;
+                    if (++i % 64 == 0) {
+                        words[i / 64 - 1] = word;
+                        word = 0;
+                    }
+                    if (i == width) {
+                        used = b + 1;
+                        break;
+                    }
+                }
+                pbm->pos += used;
+                continue;
+            }
+        }
+#endif
+        int c = next_byte(pbm);
+        if (c == '0' || c == '1') {
+            word |= (uint64_t)(c - '0') << (i % 64);
+            if (++i % 64 == 0) {
+                words[i / 64 - 1] = word;
+                word = 0;
+            }
+        } else if (c == '#') {
+            while (c != '\n' && c != EOF) c = next_byte(pbm);
+        } else if (!is_space(c)) {
+            return 0;
+        }
+    }
+    if (i % 64 != 0) words[i / 64] = word;
+    return 1;
+}
+
+/* Purpose: format_plain_row formats one row as P1 text, eight pixels per
+ *          table lookup. Whole bytes are copied 16 characters at a time
+ *          (the copy may run past the row, which the caller's slack
+ *          allows), and the row is cut to 2 * width characters with the
+ *          last space turned into a newline
+ * I: The row's words, the width, the table built by Pbm_write, and room
+ *    for 2 * width + 16 characters
+ * O: The number of characters in the row, 2 * width
+ */
+static size_t format_plain_row(const uint64_t *words, int width,
+                               const char (*table)[16], char *out)
+{
+    int nbytes = (width + 7) / 8, b;
+    for (b = 0; b < nbytes; b++) {
+        unsigned v = (words[b / 8] >> (8 * (b % 8))) & 0xff;
+        memcpy(out + 16 * b, table[v], 16);
+    }
+    out[2 * (size_t)width - 1] = '\n';
+    return 2 * (size_t)width;
+}
+
+/* Purpose: format_raw_row packs one row as P4 bytes, reversing the bits of
+ *          each byte of the row's words so the leftmost pixel is the high
+ *          bit. The padding of the last byte is 0 because Bit2 padding is
+ * I: The row's words, the width, and room for (width + 7) / 8 + 8 bytes
+ * O: The number of bytes in the row, (width + 7) / 8
+ */
+static size_t format_raw_row(const uint64_t *words, int width,
+                             unsigned char *out)
+{
+    size_t nbytes = (width + 7) / 8, b;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    int k;
+    for (k = 0; k < (width + 63) / 64; k++) {
+        uint64_t word = reverse_bytes(words[k]);
+        memcpy(out + 8 * k, &word, sizeof(word));
+    }
+    (void) b;
+#else
+    for (b = 0; b < nbytes; b++)
+        out[b] = reverse[(words[b / 8] >> (8 * (b % 8))) & 0xff];
+#endif
+    return nbytes;
+}
+
+/* Purpose: reverse_bytes reverses the order of the bits within each byte of
+ *          a word, leaving the bytes where they are
+ * I: A word
+ * O: The word with bit k of every byte moved to bit 7 - k of that byte
+ */
+static inline uint64_t reverse_bytes(uint64_t word)
+{
+    word = ((word >> 1) & 0x5555555555555555ULL)
+           | ((word & 0x5555555555555555ULL) << 1);
+    word = ((word >> 2) & 0x3333333333333333ULL)
+           | ((word & 0x3333333333333333ULL) << 2);
+    return ((word >> 4) & 0x0f0f0f0f0f0f0f0fULL)
+           | ((word & 0x0f0f0f0f0f0f0f0fULL) << 4);
+}
+
+/* Purpose: read_raw_row reads one P4 row: (width + 7) / 8 bytes, eight
+ *          pixels to a byte with the leftmost in the high bit. On little
+ *          endian machines eight bytes are loaded as a word and bit-reversed
+ *          in place; otherwise each byte is reversed through a table
+ * I: An existing and initialized Pbm_T object reading a P4 image, and room
+ *    for the row's words
+ * O: 1 if the row was read, 0 if the file ended first
+ */
+static int read_raw_row(Pbm_T pbm, uint64_t *words)
+{
+    int width = pbm->width;
+    size_t nbytes = (width + 7) / 8, done = 0;
+
+    while (done < nbytes) {
+        size_t have = fill(pbm, 1);
+        if (have == 0) return 0;
+
+        /* take as many of the row's bytes as the buffer holds, starting a
+         * new word every eight bytes
+         */
+        size_t take = nbytes - done < have ? nbytes - done : have;
+        const unsigned char *in = pbm->buf + pbm->pos;
+        size_t b;
+        for (b = 0; b < take; b++) {
+            size_t at = done + b;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            /* a whole word's bytes are already in order; only the bits of
+             * each byte need reversing
+             */
+            if (at % 8 == 0 && b + 8 <= take) {
+                uint64_t word;
+                memcpy(&word, in + b, sizeof(word));
+                words[at / 8] = reverse_bytes(word);
+                b += 7;
+                continue;
+            }
+#endif
+            if (at % 8 == 0) words[at / 8] = 0;
+            words[at / 8] |= (uint64_t)reverse[in[b]] << (8 * (at % 8));
+        }
+        pbm->pos += take;
+        done += take;
+    }
+
+    /* P4 pads the last byte of a row with bits that are not pixels */
+    if (width % 64 != 0)
+        words[width / 64] &= ((uint64_t)1 << (width % 64)) - 1;
+    return 1;
+}
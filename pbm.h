@@ -0,0 +1,116 @@
+/*
+ *      pbm.h
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code declares the Pbm_T type, a buffered reader for plain (P1)
+ *      and raw (P4) portable bit maps, and the functions used to open one,
+ *      read an image a row or a whole Bit2_T at a time, rewind it, and
+ *      close it, as well as Pbm_write and Pbm_write_rows, which write a
+ *      Bit2_T or rows handed over one at a time in either format. Rows
+ *      are read straight into Bit2 words (bit b of word k is pixel
+ *      64 * k + b, 1 is black) instead of one Pnmrdr_get call per pixel.
+ *      Errors are reported by return value rather than by exception, so a
+ *      Pbm_T can be used from any thread
+ */
+
+#ifndef PBM_INCLUDED
+#define PBM_INCLUDED
+#include <stdio.h>
+#include <stdint.h>
+#include "bit2.h"
+
+#define T Pbm_T
+typedef struct T *T;
+
+/* exported functions */
+
+/* Purpose: Pbm_open reads the header of a PBM image from a file and returns
+ *          a reader positioned at its first row. The reader keeps its own
+ *          large input buffer, so it may read past the image in the file
+ * I: A file open for reading
+ * O: A Pbm_T object, or NULL if the file does not start with a P1 or P4
+ *    header with a positive width and height (nothing is allocated then)
+ */
+T Pbm_open(FILE *fp);
+
+/* Purpose: Pbm_close frees a reader. The file is not closed
+ * I: A nonnull pointer to a Pbm_T object
+ * O: N/A
+ */
+void Pbm_close(T *pbm);
+
+/* Purpose: Pbm_width and Pbm_height return the size of the image given in
+ *          the header, and Pbm_raw returns 1 for a P4 image and 0 for P1
+ * I: An existing and initialized Pbm_T object
+ * O: The width, height, or format
+ */
+int Pbm_width(T pbm);
+int Pbm_height(T pbm);
+int Pbm_raw(T pbm);
+
+/* Purpose: Pbm_read_row reads the next row of the image into words laid
+ *          out as for Bit2_get_word; bits past the width are set to 0
+ * I: An existing and initialized Pbm_T object with rows left, and room for
+ *    (width + 63) / 64 words
+ * O: 1 if a row was read, 0 if the file ended or held something other than
+ *    pixels where the row should be
+ */
+int Pbm_read_row(T pbm, uint64_t *words);
+
+/* Purpose: Pbm_read reads the rest of the image into a new Bit2_T
+ * I: An existing and initialized Pbm_T object
+ * O: A new Bit2_T holding the image (freed with Bit2_free), or NULL if a
+ *    row could not be read
+ */
+Bit2_T Pbm_read(T pbm);
+
+/* Purpose: Pbm_bytes returns how many bytes the reader has taken from its
+ *          file so far, for reporting throughput
+ * I: An existing and initialized Pbm_T object
+ * O: The number of bytes read from the file
+ */
+long Pbm_bytes(T pbm);
+
+/* Purpose: Pbm_data_offset returns where the first row of the image starts
+ *          in the file, so the raster of a raw image can be mapped directly
+ * I: An existing and initialized Pbm_T object
+ * O: The file offset of the first row, or -1 if the file cannot tell
+ */
+long Pbm_data_offset(T pbm);
+
+/* Purpose: Pbm_rewind moves a reader back to the first row of its image,
+ *          so the image can be read again without being held in memory
+ * I: An existing and initialized Pbm_T object
+ * O: 0 on success, -1 if the file cannot seek (a pipe, for instance)
+ */
+int Pbm_rewind(T pbm);
+
+/* Purpose: Pbm_write writes a Bit2_T as a PBM image. P1 output has the
+ *          pixels of a row separated by spaces and ends each row with a
+ *          newline; it is formatted into a large buffer from a table that
+ *          turns each byte of a row's words into 16 characters. P4 output
+ *          packs eight pixels to a byte, leftmost in the high bit. Either
+ *          way the buffer goes out in large fwrite calls
+ * I: A file open for writing, an existing and initialized Bit2_T object,
+ *    and 1 for P4 or 0 for P1
+ * O: 0 on success, -1 if writing failed
+ */
+int Pbm_write(FILE *fp, Bit2_T bit2, int raw);
+
+/* Purpose: Pbm_write_rows writes a PBM image whose rows come one at a time
+ *          from a function, top to bottom, in the same formats and with the
+ *          same buffering as Pbm_write, so an image never has to be whole
+ *          in memory to be written
+ * I: A file open for writing, the width and height, 1 for P4 or 0 for P1,
+ *    a function returning the words of row j (laid out as for
+ *    Bit2_get_word, with 0 past the width) or NULL if it has none, and a
+ *    void pointer passed to it
+ * O: 0 on success, -1 if writing failed or a row could not be had
+ */
+int Pbm_write_rows(FILE *fp, int width, int height, int raw,
+                   const uint64_t *row(int j, void *cl), void *cl);
+
+#undef T
+#endif
@@ -0,0 +1,213 @@
+/*
+ *      pbmgen.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This program writes synthetic images to stdout for benchmarking:
+ *      PBM pages of any size that stress unblackedges in different ways,
+ *      and solved sudoku boards as PGM files for sudoku. The pages are
+ *      random noise of a given density (many small components), a spiral
+ *      corridor of black joined to the border (one component the fill has
+ *      to follow around every turn), all black (one component holding the
+ *      whole page), and a checkerboard (no two black pixels joined, so the
+ *      most components). The same arguments always give the same image.
+ *
+ *      Usage: pbmgen [--raw] noise|spiral|black|checker width height
+ *                    [density [seed]]
+ *             pbmgen sudoku [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "bit2.h"
+#include "pbm.h"
+#include "assert.h"
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+void noise(Bit2_T page, int density, uint64_t *seed);
+void spiral(Bit2_T page);
+void line(Bit2_T page, int *i, int *j, int di, int dj, int len);
+void checker(Bit2_T page);
+void sudoku(FILE *fp, uint64_t *seed);
+uint64_t next_random(uint64_t *seed);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int main(int argc, char *argv[])
+{
+    int raw = 0, a = 1;
+    if (a < argc && strcmp(argv[a], "--raw") == 0) {
+        raw = 1;
+        a++;
+    }
+
+    /* a seed of 0 would keep the generator at 0 forever */
+    if (a < argc && strcmp(argv[a], "sudoku") == 0 && argc - a <= 2) {
+        uint64_t seed = a + 1 < argc ? strtoull(argv[a + 1], NULL, 10) : 40;
+        seed = seed == 0 ? 40 : seed;
+        sudoku(stdout, &seed);
+        exit(EXIT_SUCCESS);
+    }
+
+    const char *kind = a < argc ? argv[a] : "";
+    int width = a + 1 < argc ? atoi(argv[a + 1]) : 0;
+    int height = a + 2 < argc ? atoi(argv[a + 2]) : 0;
+    int density = a + 3 < argc ? atoi(argv[a + 3]) : 50;
+    uint64_t seed = a + 4 < argc ? strtoull(argv[a + 4], NULL, 10) : 40;
+    seed = seed == 0 ? 40 : seed;
+    if (width <= 0 || height <= 0 || density < 0 || density > 100
+        || argc - a > 5 || (strcmp(kind, "noise") != 0
+                            && strcmp(kind, "spiral") != 0
+                            && strcmp(kind, "black") != 0
+                            && strcmp(kind, "checker") != 0)) {
+        fprintf(stderr, "usage: %s [--raw] noise|spiral|black|checker "
+                "width height [density [seed]]\n"
+                "       %s sudoku [seed]\n", argv[0], argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    Bit2_T page = Bit2_new(width, height);
+    if (strcmp(kind, "noise") == 0) noise(page, density, &seed);
+    else if (strcmp(kind, "spiral") == 0) spiral(page);
+    else if (strcmp(kind, "checker") == 0) checker(page);
+    else Bit2_not(page, page);
+
+    int status = Pbm_write(stdout, page, raw) == 0 && fflush(stdout) == 0;
+    if (!status) fprintf(stderr, "Could not write the image\n");
+    Bit2_free(&page);
+    exit(status ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/* Purpose: noise makes each pixel of a page black with a given chance
+ * I: An existing and initialized Bit2_T object, the percent of pixels to
+ *    make black, and a pointer to the random state
+ * O: N/A
+ */
+void noise(Bit2_T page, int density, uint64_t *seed)
+{
+    assert(page);
+    int width = Bit2_width(page), height = Bit2_height(page);
+    uint64_t cut = (uint64_t)density * (UINT64_MAX / 100);
+    int i, j;
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            Bit2_put(page, i, j, next_random(seed) < cut);
+}
+
+/* Purpose: spiral draws a line of black from the top left corner around
+ *          the page and inward, two pixels in from the turn before, so the
+ *          whole spiral is one component on the border with a white
+ *          corridor between its turns
+ * I: An existing and initialized Bit2_T object that is all white
+ * O: N/A
+ */
+void spiral(Bit2_T page)
+{
+    assert(page);
+    int across = Bit2_width(page) - 1, down = Bit2_height(page) - 1;
+    int i = 0, j = 0;
+
+    Bit2_put(page, 0, 0, 1);
+    line(page, &i, &j, 1, 0, across);
+    while (down > 0 && across > 0) {
+        line(page, &i, &j, 0, 1, down);
+        line(page, &i, &j, -1, 0, across);
+        down -= 2;
+        across -= 2;
+        if (down <= 0 || across <= 0) break;
+        line(page, &i, &j, 0, -1, down);
+        line(page, &i, &j, 1, 0, across);
+        down -= 2;
+        across -= 2;
+    }
+}
+
+/* Purpose: line makes len pixels black, stepping from [i, j] in direction
+ *          [di, dj], and leaves [i, j] at the last one
+ * I: An existing and initialized Bit2_T object, pointers to the position,
+ *    the direction, and the number of pixels
+ * O: N/A
+ */
+void line(Bit2_T page, int *i, int *j, int di, int dj, int len)
+{
+    for (; len > 0; len--) {
+        *i += di;
+        *j += dj;
+        Bit2_put(page, *i, *j, 1);
+    }
+}
+
+/* Purpose: checker makes every pixel whose row and column add up to an
+ *          even number black
+ * I: An existing and initialized Bit2_T object
+ * O: N/A
+ */
+void checker(Bit2_T page)
+{
+    assert(page);
+    int width = Bit2_width(page), height = Bit2_height(page);
+    int i, j;
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            Bit2_put(page, i, j, (i + j) % 2 == 0);
+}
+
+/* Purpose: sudoku writes a solved sudoku board as a PGM file: the standard
+ *          solution (row r, column c holds (3r + r / 3 + c) % 9 + 1), with
+ *          the digits, the bands, and the rows in each band shuffled, which
+ *          keeps every row, column, and box a permutation of 1 .. 9
+ * I: A file open for writing and a pointer to the random state
+ * O: N/A
+ */
+void sudoku(FILE *fp, uint64_t *seed)
+{
+    int digits[9], rows[9];
+    int k, r, c;
+    for (k = 0; k < 9; k++) {
+        digits[k] = k + 1;
+        rows[k] = k;
+    }
+    for (k = 8; k > 0; k--) {
+        int n = next_random(seed) % (k + 1), swap = digits[k];
+        digits[k] = digits[n];
+        digits[n] = swap;
+    }
+
+    /* shuffling the rows within each band, then the bands themselves */
+    for (k = 0; k < 9; k++) {
+        int n = k / 3 * 3 + next_random(seed) % 3, swap = rows[k];
+        rows[k] = rows[n];
+        rows[n] = swap;
+    }
+    for (k = 0; k < 3; k++) {
+        int n = next_random(seed) % 3;
+        for (r = 0; r < 3; r++) {
+            int swap = rows[3 * k + r];
+            rows[3 * k + r] = rows[3 * n + r];
+            rows[3 * n + r] = swap;
+        }
+    }
+
+    fprintf(fp, "P2\n9 9\n9\n");
+    for (r = 0; r < 9; r++) {
+        int row = rows[r];
+        for (c = 0; c < 9; c++)
+            fprintf(fp, "%d%c", digits[(3 * row + row / 3 + c) % 9],
+                    c == 8 ? '\n' : ' ');
+    }
+}
+
+/* Purpose: next_random steps a xorshift64 generator, so pages come out the
+ *          same on every platform
+ * I: A pointer to the nonzero random state
+ * O: The next random number
+ */
+uint64_t next_random(uint64_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return *seed;
+}
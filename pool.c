@@ -0,0 +1,239 @@
+/*
+ *      pool.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code includes the function definitions for all the functions
+ *      declared in pool.h
+ */
+
+#define _POSIX_C_SOURCE 200112L  /* for sysconf and pthreads */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pool.h"
+#include "assert.h"
+
+/* A Pool_T hands out one batch of tasks at a time. Workers sleep on wake
+ * until batch changes, then claim task numbers from next until there are
+ * none left. The last thread to finish a task signals done
+ */
+struct Pool_T {
+    int nthreads;
+    pthread_t *workers;         /* nthreads - 1 of them */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned long batch;        /* bumped for every Pool_run */
+    int stopping;
+
+    /* the batch being run */
+    void (*task)(int k, void *cl);
+    void *cl;
+    int ntasks;
+    int next;                   /* next unclaimed task */
+    int finished;               /* tasks completed */
+};
+
+static Pool_T shared = NULL;
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+static void *worker(void *arg);
+static void drain(Pool_T pool);
+static void free_shared(void);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose: Pool_ncpus returns the number of online processors
+ * I: N/A
+ * O: The number of online processors, at least 1
+ */
+int Pool_ncpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/* Purpose: Pool_new starts a pool that runs tasks on nthreads threads. The
+ *          thread calling Pool_run counts as one of them, so nthreads - 1
+ *          worker threads are created. They sleep between batches
+ * I: The number of threads, or a value <= 0 for one per online processor
+ * O: A Pool_T object
+ */
+Pool_T Pool_new(int nthreads)
+{
+    if (nthreads <= 0) nthreads = Pool_ncpus();
+    Pool_T pool = (Pool_T)malloc(sizeof(*pool));
+    assert(pool);
+
+    pool->nthreads = nthreads;
+    pool->workers = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+    assert(pool->workers);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->batch = 0;
+    pool->stopping = 0;
+    pool->task = NULL;
+    pool->cl = NULL;
+    pool->ntasks = pool->next = pool->finished = 0;
+
+    int k;
+    for (k = 0; k < nthreads - 1; k++) {
+        int failed = pthread_create(&pool->workers[k], NULL, worker, pool);
+        assert(!failed);
+        (void) failed;
+    }
+    return pool;
+}
+
+/* Purpose: Pool_free stops and joins the pool's workers and frees the pool
+ * I: A nonnull pointer to a Pool_T object that is not running a batch
+ * O: N/A
+ */
+void Pool_free(Pool_T *pool)
+{
+    assert(pool && *pool);
+    Pool_T p = *pool;
+    int k;
+
+    pthread_mutex_lock(&p->lock);
+    p->stopping = 1;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (k = 0; k < p->nthreads - 1; k++)
+        pthread_join(p->workers[k], NULL);
+
+    pthread_cond_destroy(&p->done);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->lock);
+    free(p->workers);
+    if (p == shared) shared = NULL;
+    free(p);
+    *pool = NULL;
+}
+
+/* Purpose: Pool_size returns the number of threads a pool runs tasks on,
+ *          counting the caller of Pool_run
+ * I: An existing and initialized Pool_T object
+ * O: The number of threads
+ */
+int Pool_size(Pool_T pool)
+{
+    assert(pool);
+    return pool->nthreads;
+}
+
+/* Purpose: Pool_run calls task(k, cl) once for every k in [0, ntasks) and
+ *          returns when all of them have finished. Tasks are handed out in
+ *          increasing order to whichever thread is free, so several tasks
+ *          can run at once and a task must not assume which thread runs it
+ * I: An existing and initialized Pool_T object that is not already running
+ *    a batch, a nonnegative number of tasks, the task function, and a void
+ *    pointer passed to every task
+ * O: N/A
+ */
+void Pool_run(Pool_T pool, int ntasks, void task(int k, void *cl), void *cl)
+{
+    assert(pool && task);
+    assert(ntasks >= 0);
+    if (ntasks == 0) return;
+
+    /* a single thread has nobody to hand work to */
+    if (pool->nthreads == 1 || ntasks == 1) {
+        int k;
+        for (k = 0; k < ntasks; k++) task(k, cl);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->cl = cl;
+    pool->ntasks = ntasks;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->batch++;
+    pthread_cond_broadcast(&pool->wake);
+
+    /* the caller works on the batch too, then waits for the stragglers */
+    drain(pool);
+    while (pool->finished < pool->ntasks)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pool->task = NULL;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Purpose: Pool_shared returns a process-wide pool with at least nthreads
+ *          threads, creating or growing it on first use, so repeated
+ *          parallel maps do not pay for thread creation. The shared pool is
+ *          freed at exit. It must only be used from one thread at a time
+ * I: The number of threads needed, or a value <= 0 for one per online
+ *    processor
+ * O: The shared Pool_T object
+ */
+Pool_T Pool_shared(int nthreads)
+{
+    static int registered = 0;
+    if (nthreads <= 0) nthreads = Pool_ncpus();
+    if (shared != NULL && shared->nthreads < nthreads) Pool_free(&shared);
+    if (shared == NULL) shared = Pool_new(nthreads);
+    if (!registered) {
+        atexit(free_shared);
+        registered = 1;
+    }
+    return shared;
+}
+
+/* Purpose: worker is the body of every pool thread. It waits for a new
+ *          batch, helps drain it, and exits when the pool is stopping
+ * I: A void pointer to the Pool_T the thread belongs to
+ * O: NULL
+ */
+static void *worker(void *arg)
+{
+    Pool_T pool = arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->batch == seen)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stopping) break;
+        seen = pool->batch;
+        drain(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* Purpose: drain claims and runs tasks of the current batch until none are
+ *          left unclaimed. The lock is dropped while a task runs
+ * I: A Pool_T whose lock is held by the caller
+ * O: N/A (the lock is held again on return)
+ */
+static void drain(Pool_T pool)
+{
+    while (pool->task != NULL && pool->next < pool->ntasks) {
+        int k = pool->next++;
+        void (*task)(int k, void *cl) = pool->task;
+        void *cl = pool->cl;
+
+        pthread_mutex_unlock(&pool->lock);
+        task(k, cl);
+        pthread_mutex_lock(&pool->lock);
+
+        if (++pool->finished == pool->ntasks)
+            pthread_cond_broadcast(&pool->done);
+    }
+}
+
+/* Purpose: free_shared releases the shared pool; registered with atexit
+ * I: N/A
+ * O: N/A
+ */
+static void free_shared(void)
+{
+    if (shared != NULL) Pool_free(&shared);
+}
@@ -0,0 +1,71 @@
+/*
+ *      pool.h
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code declares the Pool_T type, a reusable pool of pthread
+ *      workers, and the functions used to create one, hand it a batch of
+ *      numbered tasks, and free it. The parallel map functions of UArray2
+ *      and Bit2 run their bands on a pool
+ */
+
+#ifndef POOL_INCLUDED
+#define POOL_INCLUDED
+
+#define T Pool_T
+typedef struct T *T;
+
+/* exported functions */
+
+/* Purpose: Pool_new starts a pool that runs tasks on nthreads threads. The
+ *          thread calling Pool_run counts as one of them, so nthreads - 1
+ *          worker threads are created. They sleep between batches
+ * I: The number of threads, or a value <= 0 for one per online processor
+ * O: A Pool_T object
+ */
+T Pool_new(int nthreads);
+
+/* Purpose: Pool_free stops and joins the pool's workers and frees the pool
+ * I: A nonnull pointer to a Pool_T object that is not running a batch
+ * O: N/A
+ */
+void Pool_free(T *pool);
+
+/* Purpose: Pool_size returns the number of threads a pool runs tasks on,
+ *          counting the caller of Pool_run
+ * I: An existing and initialized Pool_T object
+ * O: The number of threads
+ */
+int Pool_size(T pool);
+
+/* Purpose: Pool_run calls task(k, cl) once for every k in [0, ntasks) and
+ *          returns when all of them have finished. Tasks are handed out in
+ *          increasing order to whichever thread is free, so several tasks
+ *          can run at once and a task must not assume which thread runs it
+ * I: An existing and initialized Pool_T object that is not already running
+ *    a batch, a nonnegative number of tasks, the task function, and a void
+ *    pointer passed to every task
+ * O: N/A
+ */
+void Pool_run(T pool, int ntasks, void task(int k, void *cl), void *cl);
+
+/* Purpose: Pool_shared returns a process-wide pool with at least nthreads
+ *          threads, creating or growing it on first use, so repeated
+ *          parallel maps do not pay for thread creation. The shared pool is
+ *          freed at exit. It must only be used from one thread at a time
+ * I: The number of threads needed, or a value <= 0 for one per online
+ *    processor
+ * O: The shared Pool_T object
+ */
+T Pool_shared(int nthreads);
+
+/* Purpose: Pool_ncpus returns the number of online processors
+ * I: N/A
+ * O: The number of online processors, at least 1
+ */
+int Pool_ncpus(void);
+
+
+#undef T
+#endif
@@ -12,8 +12,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <pnmrdr.h>
 #include "uarray2.h"
+#include "uarray2_typed.h"
 #include "assert.h"
 
 
@@ -27,9 +29,7 @@ struct info {
 
 /* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
 void store_pixel(int i, int j, UArray2_T uarray2, void *elem, void *cl);
-void check_rows(int row, int col, UArray2_T uarray2, void *elem, void *cl);
-void check_cols(int row, int col, UArray2_T uarray2, void *elem, void *cl);
-void check_boxes(UArray2_T uarray2, struct info *imageInfo);
+int check_solution(UArray2_T uarray2);
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 int main(int argc, char *argv[])
@@ -49,6 +49,7 @@ int main(int argc, char *argv[])
             exit(EXIT_FAILURE);
         END_TRY;
     } else if (argc == 1) {
+        fp = stdin;
         TRY
             reader = Pnmrdr_new(stdin);
         EXCEPT(Pnmrdr_Badformat)
@@ -79,29 +80,27 @@ int main(int argc, char *argv[])
      * the Pnmrdr to pass into map_row_major as the closure var.
      * This will allow us to free them if needed.
      */
-    UArray2_T sudoku = UArray2_new(9, 9, sizeof(unsigned int));
+    UArray2_int sudoku = UArray2_int_new(9, 9);
     struct info* imageInfo = (struct info *) malloc(sizeof(struct info));
     imageInfo->reader = reader;
     imageInfo->fp = fp;
-    UArray2_map_row_major(sudoku, store_pixel, imageInfo);
+    UArray2_map_row_major(sudoku.base, store_pixel, imageInfo);
 
     /* checking that each row, col, and 3x3 box contains 9 distint numbers */
-    UArray2_map_row_major(sudoku, check_rows, imageInfo);
-    UArray2_map_col_major(sudoku, check_cols, imageInfo);
-    check_boxes(sudoku, imageInfo);
+    int solved = check_solution(sudoku.base);
 
     /* freeing the Pnmrdr_T and UArray2_T objects, the struct of the 
      * imageinfo, and closing the input file 
      */
-    UArray2_free(&sudoku);
+    UArray2_int_free(&sudoku);
     Pnmrdr_free(&reader);
     free(imageInfo);
     fclose(fp);
 
-    /* if the program has not output 1 at the end of main, then the graymap
-     * is a solved sudoku puzzle, so exit with a code of 0
+    /* if the program has not output 1 before the end of main, the graymap
+     * is a solved sudoku puzzle exactly when check_solution found it so
      */
-    exit(0);
+    exit(solved ? 0 : 1);
 }
 
 /* Purpose: store_pixel stores a given pixel within a pgm in the matching
@@ -117,8 +116,8 @@ void store_pixel(int i, int j, UArray2_T uarray2, void *elem, void *cl)
     assert(uarray2);
     (void) elem;
     int temp = Pnmrdr_get(((struct info *)cl)->reader);
-    *((int *)UArray2_at(uarray2, i, j)) = temp;
-    if (*(int *)UArray2_at(uarray2, i, j) <= 0) {
+    UArray2_int_put(UArray2_int_wrap(uarray2), i, j, temp);
+    if (temp <= 0) {
         UArray2_free(&uarray2);
         Pnmrdr_free(&(((struct info *)cl)->reader));
         fclose(((struct info *)cl)->fp);
@@ -127,88 +126,33 @@ void store_pixel(int i, int j, UArray2_T uarray2, void *elem, void *cl)
     } 
 }
 
-/* Purpose: check_rows checks if the rows within a given Sudoku puzzle are
- *          solved. Solved means no two elements in a row are the same
- *          number. If a given row isn't solved, check_rows exit(1)'s.'
- *          Frees cl's properties if exiting with code of 1.
- * I: An existing and initialized UArray2_T object
- * O: N/A
- */
-void check_rows(int row, int col, UArray2_T uarray2, void *elem, void *cl)
-{
-    assert(uarray2);
-    int i;
-    for (i = 0; i < uarray2->width; i++) {
-        if (UArray2_at(uarray2, i, col) == elem) {
-            if (i != row) {
-                UArray2_free(&uarray2);
-                Pnmrdr_free(&((struct info *)cl)->reader);
-                fclose(((struct info *)cl)->fp);
-                free((struct info *)cl);
-                exit(1);
-            } 
-        }
-    }
-}
-
-/* Purpose: check_cols checks if the columns within a given Sudoku puzzle are
- *          solved. Solved means no two elements in a column are the same
- *          number. If a given column isn't solved, check_cols exit(1)'s.'
-*           Frees cl's properties if exiting with code of 1.
- * I: An existing and initialized UArray2_T object
- * O: N/A
+/* Purpose: check_solution checks if a given Sudoku puzzle is solved, that
+ *          is, if no row, column, or 3x3 box holds the same number twice.
+ *          It makes one pass over the cells, keeping a 16-bit mask of the
+ *          numbers already seen in each row, column, and box (bit v is set
+ *          once v has been seen), and stops at the first number that is out
+ *          of range or already in its row, column, or box
+ * I: An existing and initialized 9x9 UArray2_T object of ints
+ * O: 1 if the puzzle is solved, 0 if it is not
  */
-void check_cols(int row, int col, UArray2_T uarray2, void *elem, void *cl)
+int check_solution(UArray2_T uarray2)
 {
     assert(uarray2);
-    int i;
-    for (i = 0; i < uarray2->height; i++) {
-        if (UArray2_at(uarray2, row, i) == elem) {
-            if (i != col) {
-                UArray2_free(&uarray2);
-                Pnmrdr_free(&((struct info *)cl)->reader);
-                fclose(((struct info *)cl)->fp);
-                free((struct info *)cl);
-                exit(1);
-            }
-        }
-    }
-}
-
-/* Purpose: check_boxes checks if the 3x3 boxes within a given Sudoku puzzle
- *          are solved. Solved means no two elements in a box are the same
- *          number. If a given box isn't solved, check_boxes exit(1)'s.
-*           Frees the FILE * and Pnmrdr if exiting with code of 1.
- * I: An existing and initialized UArray2_T object, and a struct containing
- *    a FILE * and a Pnmrdr (to be freed)
- * O: N/A
- */
-void check_boxes(UArray2_T uarray2, struct info *imageInfo)
-{
-    assert(uarray2);
-    int row, col, i , j, x, y;
-
-    /* for loops and box checking are based on the
-       top left element in each box */
-    for (row = 0; row < 9; row += 3) {
-        for (col = 0; col < 9; col += 3) {
-            int box[9];     /* stores the values in a given box */
-            for (i = row; i < row + 3; i++) {
-                for (j = col; j < col + 3; j++)
-                    box[(3 * (i - row)) + (j - col)]
-                        = *((int *)UArray2_at(uarray2, i, j));
-            }
-            for (x = 0; x < 9; x++) {       /* compares elements in the box */
-                for (y = 0; y < 9; y++) {
-                    if ((box[y] == box[x]) && (x != y)) {
-                        UArray2_free(&uarray2);
-                        Pnmrdr_free(&(imageInfo->reader));
-                        fclose(imageInfo->fp);
-                        free(imageInfo);
-                        exit(1);
-                    }
-                }
-            }
+    uint16_t rows[9] = { 0 }, cols[9] = { 0 }, boxes[9] = { 0 };
+    int i, j;
+    for (j = 0; j < 9; j++) {
+        const int *row = UArray2_row(uarray2, j, NULL);
+        for (i = 0; i < 9; i++) {
+            int value = row[i], box = j / 3 * 3 + i / 3;
+            if (value < 1 || value > 9)
+                return 0;
+            uint16_t bit = 1 << value;
+            if ((rows[j] | cols[i] | boxes[box]) & bit)
+                return 0;
+            rows[j] |= bit;
+            cols[i] |= bit;
+            boxes[box] |= bit;
         }
     }
+    return 1;
 }
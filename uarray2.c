@@ -8,14 +8,79 @@
  *      declared in uarray2.h
  */
 
+#define _POSIX_C_SOURCE 200112L  /* for posix_memalign */
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "uarray2.h"
-#include "uarray.h"
+#include "pool.h"
+
+/* alignment of the element block; one cache line on the machines we use */
+#define UARRAY2_ALIGN 64
+
+/* header at the start of a file made by UArray2_map_file; the layout is
+ * documented in uarray2.h
+ */
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t offset;
+    int32_t width;
+    int32_t height;
+    int32_t size;
+    char reserved[36];
+};
+
+#define UARRAY2_MAGIC "UARRAY2"
+#define UARRAY2_VERSION 1
+
+/* the strictest alignment an element type can need (long double) */
+#define UARRAY2_MAX_ELEM_ALIGN 16
+
+/* struct passed to map_band through Pool_run, describing one parallel map */
+struct band_job {
+    UArray2_T uarray2;
+    void (*apply)(int i, int j, UArray2_T uarray2, void *elem, void *cl);
+    void **cls;
+    int nbands;
+    int by_col;     /* 1 for column bands in column-major order */
+};
+
+/* the reorientations that move rows into columns, and the struct passed
+ * down the recursion of reorient_tile
+ */
+enum orient { TRANSPOSE, ROTATE90, ROTATE270 };
+struct reorient {
+    UArray2_T src;
+    UArray2_T dst;
+    enum orient how;
+};
+
+/* largest tile (in elements) reorient_tile copies without splitting; 16 x 16
+ * elements of up to 64 bytes fit comfortably in L1 on both sides
+ */
+#define REORIENT_TILE 256
+
+static void map_band(int k, void *cl);
+static void advise(UArray2_T uarray2, int advice);
+static size_t elem_align(int size);
+static UArray2_T reorient(UArray2_T uarray2, enum orient how);
+static void reorient_tile(struct reorient *r, int x0, int y0, int x1, int y1);
+static UArray2_T mirror(UArray2_T uarray2, int flip_x, int flip_y);
+static void map_par(struct band_job *job,
+                    void reduce(void *cl, void *worker_cl));
 
 /* Purpose: UArray2_new instantiates a UArray2_T object, allocates adequate
  *          memory for it, and initializes the struct variables using
- *          the parameters and the Ramsey/Hanson UArray_T function
+ *          the parameters. All elements are zeroed
  * I: Two nonnegative integer values representing the width and
  *    height of the 2D uarray.
  * O: A UArray2_T object
@@ -23,41 +88,228 @@
 UArray2_T UArray2_new(int row, int col, int size)
 {
     assert(row >= 0 && col >= 0);
-    UArray2_T uarray2 = (UArray2_T)malloc(4 * sizeof(UArray2_T));
+    assert(size > 0);
+    UArray2_T uarray2 = (UArray2_T)malloc(sizeof(*uarray2));
+    assert(uarray2);
 
     uarray2->width = row;
     uarray2->height = col;
     uarray2->size = size;
+    uarray2->stride = row * size;
+    uarray2->owner = UARRAY2_HEAP;
+    uarray2->map = NULL;
+    uarray2->map_len = 0;
+
+    /* one block holds every element, so a row-major traversal is a linear
+     * scan. Always allocate at least one line so elems is never NULL
+     */
+    size_t nbytes = (size_t)row * col * size;
+    void *elems = NULL;
+    if (posix_memalign(&elems, UARRAY2_ALIGN,
+                       nbytes > 0 ? nbytes : UARRAY2_ALIGN) != 0)
+        elems = NULL;
+    assert(elems);
+    memset(elems, 0, nbytes);
+    uarray2->elems = elems;
+
+    return uarray2;
+}
+
+/* Purpose: UArray2_new_in is UArray2_new with the UArray2_T and its
+ *          elements allocated from an arena, so that many short-lived
+ *          arrays cost one allocation each and can all be released at once
+ *          with Arena_free(arena). UArray2_free on such an array only clears
+ *          the caller's pointer
+ * I: An existing Arena_T, and the width, height, and element size as for
+ *    UArray2_new
+ * O: A UArray2_T object that lives as long as the arena's current contents
+ */
+UArray2_T UArray2_new_in(Arena_T arena, int row, int col, int size)
+{
+    assert(arena);
+    assert(row >= 0 && col >= 0);
+    assert(size > 0);
 
-    /* Iterates through each element of uarray2's rowArray and defines a new
-     * new UArray_T object. This allows 2D indexing
+    /* the struct and the elements share one arena allocation; the slack
+     * lets the elements start on a cache line like UArray2_new's do
      */
-    uarray2->rowArray = UArray_new(row, 2 * sizeof(UArray_T));
-    int i;
-    for(i = 0; i < row; i++) {    //cast UArray_at as a variable type
-        UArray_T colArray = UArray_new(col, size);
-        *(UArray_T *)UArray_at(uarray2->rowArray, i) = colArray;
+    size_t nbytes = (size_t)row * col * size;
+    char *block = Arena_alloc(arena, sizeof(struct UArray2_T)
+                              + UARRAY2_ALIGN + nbytes, __FILE__, __LINE__);
+    UArray2_T uarray2 = (UArray2_T)block;
+    uintptr_t elems = (uintptr_t)(block + sizeof(struct UArray2_T));
+    elems = (elems + UARRAY2_ALIGN - 1) & ~(uintptr_t)(UARRAY2_ALIGN - 1);
+
+    uarray2->width = row;
+    uarray2->height = col;
+    uarray2->size = size;
+    uarray2->stride = row * size;
+    uarray2->elems = (char *)elems;
+    uarray2->owner = UARRAY2_ARENA;
+    uarray2->map = NULL;
+    uarray2->map_len = 0;
+    memset(uarray2->elems, 0, nbytes);
+
+    return uarray2;
+}
+
+/* Purpose: UArray2_wrap makes a UArray2_T over a caller-owned buffer
+ *          without copying it. The buffer holds the elements in row-major
+ *          order (width * height * size bytes) and keeps its contents, so it
+ *          can be preallocated, huge-page, or shared memory. UArray2_free
+ *          frees the UArray2_T but never the buffer
+ * I: A nonnull buffer of at least width * height * size bytes aligned for
+ *    the element type, and the width, height, and element size
+ * O: A UArray2_T object whose elements are the buffer
+ */
+UArray2_T UArray2_wrap(void *elems, int row, int col, int size)
+{
+    assert(elems);
+    assert(row >= 0 && col >= 0);
+    assert(size > 0);
+    UArray2_T uarray2 = (UArray2_T)malloc(sizeof(*uarray2));
+    assert(uarray2);
+
+    uarray2->width = row;
+    uarray2->height = col;
+    uarray2->size = size;
+    uarray2->stride = row * size;
+    uarray2->elems = elems;
+    uarray2->owner = UARRAY2_WRAPPED;
+    uarray2->map = NULL;
+    uarray2->map_len = 0;
+
+    return uarray2;
+}
+
+/* Purpose: UArray2_map_file makes a UArray2_T backed by a memory-mapped
+ *          file, so arrays larger than physical memory are paged in and out
+ *          by the kernel's page cache instead of being read or written
+ *          explicitly. Reopening a file costs one header check. The map
+ *          functions advise the kernel of their access pattern (sequential
+ *          for row-major, random for column-major)
+ * I: A path, the width, height, and element size, and flags (see
+ *    uarray2.h for the flags and the file layout)
+ * O: A UArray2_T object, or NULL (with errno set) if the file cannot be
+ *    created, opened, or mapped, or its header does not match or is bad:
+ *    a row wider than INT_MAX bytes, or an offset not aligned for the
+ *    element size
+ */
+UArray2_T UArray2_map_file(const char *path, int width, int height, int size,
+                           int flags)
+{
+    assert(path);
+    assert(width >= 0 && height >= 0 && size >= 0);
+    int rdonly = (flags & UARRAY2_RDONLY) != 0;
+    int fd;
+    struct file_header header;
+    struct stat st;
+
+    if (flags & UARRAY2_CREATE) {
+        /* a fresh file: write the header and let ftruncate supply the
+         * zeroed (and, on most file systems, sparse) payload
+         */
+        assert(width > 0 && height > 0 && size > 0);
+        assert((size_t)width * size <= INT_MAX);
+        assert(!rdonly);
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) return NULL;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, UARRAY2_MAGIC, sizeof(UARRAY2_MAGIC));
+        header.version = UARRAY2_VERSION;
+        header.offset = sizeof(header);
+        header.width = width;
+        header.height = height;
+        header.size = size;
+        if (write(fd, &header, sizeof(header)) != sizeof(header)
+            || ftruncate(fd, sizeof(header)
+                             + (off_t)width * height * size) != 0) {
+            close(fd);
+            return NULL;
+        }
+    } else {
+        fd = open(path, rdonly ? O_RDONLY : O_RDWR);
+        if (fd < 0) return NULL;
+
+        /* the header is untrusted: a row's stride must fit in an int, and
+         * the elements must start at an offset aligned like the element
+         * type, the largest power of two dividing the size (at most
+         * UARRAY2_MAX_ELEM_ALIGN)
+         */
+        if (read(fd, &header, sizeof(header)) != sizeof(header)
+            || memcmp(header.magic, UARRAY2_MAGIC, sizeof(UARRAY2_MAGIC))
+            || header.version != UARRAY2_VERSION
+            || header.offset < sizeof(header)
+            || header.width < 0 || header.height < 0 || header.size <= 0
+            || (width != 0 && header.width != width)
+            || (height != 0 && header.height != height)
+            || (size != 0 && header.size != size)
+            || (size_t)header.width * header.size > INT_MAX
+            || header.offset % elem_align(header.size) != 0) {
+            close(fd);
+            errno = EINVAL;
+            return NULL;
+        }
     }
 
+    /* the file must hold every element the header promises */
+    size_t map_len = header.offset
+                     + (size_t)header.width * header.height * header.size;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < map_len) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void *map = mmap(NULL, map_len, rdonly ? PROT_READ
+                                           : PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    UArray2_T uarray2 = (UArray2_T)malloc(sizeof(*uarray2));
+    assert(uarray2);
+    uarray2->width = header.width;
+    uarray2->height = header.height;
+    uarray2->size = header.size;
+    uarray2->stride = header.width * header.size;
+    uarray2->elems = (char *)map + header.offset;
+    uarray2->owner = UARRAY2_MAPPED;
+    uarray2->map = map;
+    uarray2->map_len = map_len;
+
     return uarray2;
 }
 
-/* Purpose: UArray2_free frees memory allocated for the UArray2_T's rowArray
- *          varaible
+/* Purpose: UArray2_free frees memory allocated for the UArray2_T and, if
+ *          UArray2_new allocated them, its elements. A file-backed array is
+ *          unmapped
  * I: A nonnull pointer to a UArray2_T object
  * O: N/A
  */
 void UArray2_free(UArray2_T *uarray2)
 {
-    // assert(uarray2);
-    int i;
-
-    /* frees all of the UArray_T objects within rowArray */
-    for(i = 0; i < (*uarray2)->width; i++)
-        UArray_free((UArray_T *)UArray_at((*uarray2)->rowArray, i));
-
-    UArray_free(&(*uarray2)->rowArray);
-    free(*uarray2);
+    assert(uarray2 && *uarray2);
+    switch ((*uarray2)->owner) {
+    case UARRAY2_HEAP:
+        free((*uarray2)->elems);
+        free(*uarray2);
+        break;
+    case UARRAY2_WRAPPED:
+        free(*uarray2);
+        break;
+    case UARRAY2_MAPPED:
+        munmap((*uarray2)->map, (*uarray2)->map_len);
+        free(*uarray2);
+        break;
+    case UARRAY2_ARENA:
+        /* released with the rest of the arena by Arena_free */
+        break;
+    case UARRAY2_VIEW:
+        /* views own nothing and are never handed out by pointer */
+        assert(0);
+        break;
+    }
+    *uarray2 = NULL;
 }
 
 /* Purpose: UArray2_width returns the value for the width of a given UArray2_T
@@ -104,7 +356,75 @@ void *UArray2_at(UArray2_T uarray2, int i, int j)
     assert(uarray2);
     assert(i >= 0 && j >= 0);
     assert(i < UArray2_width(uarray2) && j < UArray2_height(uarray2));
-    return UArray_at(*(UArray_T *)UArray_at(uarray2->rowArray, i), j);
+    return uarray2->elems + (size_t)j * uarray2->stride
+           + (size_t)i * uarray2->size;
+}
+
+/* Purpose: UArray2_row returns a pointer to the first element of row j.
+ *          The row's elements are contiguous, so element [i, j] is at byte
+ *          offset i * size from it, and callers can run their own loop
+ *          over the row without a call or bounds check per element
+ * I: An existing and initialized UArray2_T object, a row number j that is
+ *    nonnegative and less than the height, and a pointer that receives the
+ *    number of elements in the row (may be NULL)
+ * O: A void pointer to element [0, j]
+ */
+void *UArray2_row(UArray2_T uarray2, int j, int *len)
+{
+    assert(uarray2);
+    assert(j >= 0 && j < uarray2->height);
+    if (len != NULL) *len = uarray2->width;
+    return uarray2->elems + (size_t)j * uarray2->stride;
+}
+
+/* Purpose: UArray2_view returns a window onto the w x h rectangle of a
+ *          UArray2_T whose top left element is [x, y]. Element [i, j] of the
+ *          view is element [x + i, y + j] of the array, so writes through
+ *          the view change the array. A view is returned by value, owns
+ *          nothing, and never allocates; pass its address to any UArray2
+ *          function (including UArray2_view) except UArray2_free
+ * I: An existing and initialized UArray2_T object (or view), and a
+ *    rectangle that lies inside it
+ * O: A struct UArray2_T describing the window
+ */
+struct UArray2_T UArray2_view(UArray2_T uarray2, int x, int y, int w, int h)
+{
+    assert(uarray2);
+    assert(x >= 0 && y >= 0 && w >= 0 && h >= 0);
+    assert(x + w <= uarray2->width && y + h <= uarray2->height);
+
+    struct UArray2_T view = *uarray2;
+    view.width = w;
+    view.height = h;
+    view.elems = uarray2->elems + (size_t)y * uarray2->stride
+                 + (size_t)x * uarray2->size;
+    view.owner = UARRAY2_VIEW;
+    view.map = NULL;
+    view.map_len = 0;
+    return view;
+}
+
+/* Purpose: UArray2_map_rows applies a certain function to every row of a
+ *          given UArray2_T object, top to bottom, handing it the whole row
+ *          at once as a pointer and a length
+ * I: An existing and initailized UArray2_T object, an apply function that
+ *    takes in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void UArray2_map_rows(UArray2_T uarray2,
+                      void apply(int j, UArray2_T uarray2, void *row, int len,
+                      void *cl), void *cl)
+{
+    assert(uarray2);
+    int j;
+    size_t stride = uarray2->stride;
+    char *row = uarray2->elems;
+    advise(uarray2, POSIX_MADV_SEQUENTIAL);
+    for (j = 0; j < uarray2->height; j++) {
+        apply(j, uarray2, row, uarray2->width, cl);
+        row += stride;
+    }
 }
 
 /* Purpose: UArray2_map_row_major applies a certain function to all of the
@@ -121,10 +441,16 @@ void UArray2_map_row_major(UArray2_T uarray2,
 {
     assert(uarray2);
     int i, j;       // [i, j] represents [row position, col position]
+    int size = uarray2->size;
+    advise(uarray2, POSIX_MADV_SEQUENTIAL);
     for (j = 0; j < uarray2->height; j++) {
+        char *elem = uarray2->elems + (size_t)j * uarray2->stride;
         for (i = 0; i < uarray2->width; i++) {
-            /* col position is getting bigger faster */
-            apply(i, j, uarray2, UArray2_at(uarray2, i, j), cl);
+            /* col position is getting bigger faster, so the elements are
+             * visited in storage order
+             */
+            apply(i, j, uarray2, elem, cl);
+            elem += size;
         }
     }
 }
@@ -143,10 +469,318 @@ void UArray2_map_col_major(UArray2_T uarray2,
 {
     assert(uarray2);
     int i, j;       // [i, j] represents [row position, col position]
+    size_t size = uarray2->size;
+    size_t stride = uarray2->stride;
+    advise(uarray2, POSIX_MADV_RANDOM);
     for (i = 0; i < uarray2->width; i++) {
+        char *elem = uarray2->elems + i * size;
         for (j = 0; j < uarray2->height; j++) {
             /* row position is getting bigger faster */
-            apply(i, j, uarray2, UArray2_at(uarray2, i, j), cl);
+            apply(i, j, uarray2, elem, cl);
+            elem += stride;
         }
     }
 }
+
+/* Purpose: UArray2_map_row_major_par applies a certain function to all of
+ *          the elements within a given UArray2_T object on nthreads threads
+ *          from the shared Pool_T. The rows are split into nthreads bands of
+ *          consecutive rows and band k is visited in row-major order with
+ *          cls[k] as its closure, so workers never share a closure. Once
+ *          every band is done, reduce (if not NULL) is called as
+ *          reduce(cls[0], cls[k]) for k = 1 .. nthreads - 1 in that order to
+ *          merge the results into cls[0]. apply may only write the element
+ *          it is given
+ * I: An existing and initialized UArray2_T object, an apply function that
+ *    takes in the parameters specified below, an array of nthreads closures
+ *    (or NULL, in which case every worker gets NULL), a positive number of
+ *    threads, and a reduce function (or NULL)
+ * O: N/A
+ */
+void UArray2_map_row_major_par(UArray2_T uarray2,
+                               void apply(int i, int j, UArray2_T uarray2,
+                               void *elem, void *cl), void *cls[],
+                               int nthreads,
+                               void reduce(void *cl, void *worker_cl))
+{
+    assert(uarray2 && apply);
+    assert(nthreads > 0);
+    struct band_job job = { uarray2, apply, cls, nthreads, 0 };
+    map_par(&job, reduce);
+}
+
+/* Purpose: UArray2_map_col_major_par is UArray2_map_row_major_par with the
+ *          array split into bands of consecutive columns, each visited in
+ *          column-major order
+ * I: An existing and initialized UArray2_T object, an apply function that
+ *    takes in the parameters specified below, an array of nthreads closures
+ *    (or NULL, in which case every worker gets NULL), a positive number of
+ *    threads, and a reduce function (or NULL)
+ * O: N/A
+ */
+void UArray2_map_col_major_par(UArray2_T uarray2,
+                               void apply(int i, int j, UArray2_T uarray2,
+                               void *elem, void *cl), void *cls[],
+                               int nthreads,
+                               void reduce(void *cl, void *worker_cl))
+{
+    assert(uarray2 && apply);
+    assert(nthreads > 0);
+    struct band_job job = { uarray2, apply, cls, nthreads, 1 };
+    map_par(&job, reduce);
+}
+
+/* Purpose: UArray2_transpose returns a new UArray2_T holding the transpose
+ *          of a given one: element [i, j] of the source is element [j, i]
+ *          of the result. The copy recursively splits the source into
+ *          tiles small enough to stay in cache on both sides, whatever the
+ *          cache size, so it avoids the cache misses of a per-element copy
+ *          that strides through the destination
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new height x width UArray2_T, freed with UArray2_free
+ */
+UArray2_T UArray2_transpose(UArray2_T uarray2)
+{
+    return reorient(uarray2, TRANSPOSE);
+}
+
+/* Purpose: UArray2_rotate90 returns a new UArray2_T holding a given one
+ *          rotated 90 degrees clockwise, so element [i, j] of the source is
+ *          element [height - 1 - j, i] of the result. It uses the same
+ *          cache-oblivious tiling as UArray2_transpose
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new height x width UArray2_T, freed with UArray2_free
+ */
+UArray2_T UArray2_rotate90(UArray2_T uarray2)
+{
+    return reorient(uarray2, ROTATE90);
+}
+
+/* Purpose: UArray2_rotate180 returns a new UArray2_T holding a given one
+ *          rotated 180 degrees, so element [i, j] of the source is element
+ *          [width - 1 - i, height - 1 - j] of the result
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new width x height UArray2_T, freed with UArray2_free
+ */
+UArray2_T UArray2_rotate180(UArray2_T uarray2)
+{
+    return mirror(uarray2, 1, 1);
+}
+
+/* Purpose: UArray2_rotate270 returns a new UArray2_T holding a given one
+ *          rotated 270 degrees clockwise, so element [i, j] of the source is
+ *          element [j, width - 1 - i] of the result. It uses the same
+ *          cache-oblivious tiling as UArray2_transpose
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new height x width UArray2_T, freed with UArray2_free
+ */
+UArray2_T UArray2_rotate270(UArray2_T uarray2)
+{
+    return reorient(uarray2, ROTATE270);
+}
+
+/* Purpose: UArray2_flip_horizontal returns a new UArray2_T holding a given
+ *          one mirrored left to right, so element [i, j] of the source is
+ *          element [width - 1 - i, j] of the result
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new width x height UArray2_T, freed with UArray2_free
+ */
+UArray2_T UArray2_flip_horizontal(UArray2_T uarray2)
+{
+    return mirror(uarray2, 1, 0);
+}
+
+/* Purpose: UArray2_flip_vertical returns a new UArray2_T holding a given
+ *          one mirrored top to bottom, so element [i, j] of the source is
+ *          element [i, height - 1 - j] of the result
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new width x height UArray2_T, freed with UArray2_free
+ */
+UArray2_T UArray2_flip_vertical(UArray2_T uarray2)
+{
+    return mirror(uarray2, 0, 1);
+}
+
+/* Purpose: copy_elem copies one element, with the common sizes spelled out
+ *          so the compiler turns them into a single load and store
+ * I: Destination and source pointers and the element size
+ * O: N/A
+ */
+static inline void copy_elem(char *dst, const char *src, int size)
+{
+    switch (size) {
+    case 1: *dst = *src; break;
+    case 2: memcpy(dst, src, 2); break;
+    case 4: memcpy(dst, src, 4); break;
+    case 8: memcpy(dst, src, 8); break;
+    default: memcpy(dst, src, size); break;
+    }
+}
+
+/* Purpose: reorient makes the destination of a transpose or a 90/270 degree
+ *          rotation and fills it
+ * I: An existing and initialized UArray2_T object and the reorientation
+ * O: A new height x width UArray2_T
+ */
+static UArray2_T reorient(UArray2_T uarray2, enum orient how)
+{
+    assert(uarray2);
+    struct reorient r;
+    r.src = uarray2;
+    r.dst = UArray2_new(uarray2->height, uarray2->width, uarray2->size);
+    r.how = how;
+    reorient_tile(&r, 0, 0, uarray2->width, uarray2->height);
+    return r.dst;
+}
+
+/* Purpose: reorient_tile copies the source rectangle [x0, x1) x [y0, y1)
+ *          into its place in the destination. Rectangles larger than
+ *          REORIENT_TILE are halved across their longer side, so at some
+ *          level of the recursion the tile fits each level of cache on both
+ *          the source and the destination side
+ * I: The reorientation in progress and a rectangle of the source
+ * O: N/A
+ */
+static void reorient_tile(struct reorient *r, int x0, int y0, int x1, int y1)
+{
+    if ((long)(x1 - x0) * (y1 - y0) > REORIENT_TILE) {
+        if (x1 - x0 >= y1 - y0) {
+            int xm = x0 + (x1 - x0) / 2;
+            reorient_tile(r, x0, y0, xm, y1);
+            reorient_tile(r, xm, y0, x1, y1);
+        } else {
+            int ym = y0 + (y1 - y0) / 2;
+            reorient_tile(r, x0, y0, x1, ym);
+            reorient_tile(r, x0, ym, x1, y1);
+        }
+        return;
+    }
+
+    UArray2_T src = r->src, dst = r->dst;
+    int size = src->size;
+    int i, j;
+    for (j = y0; j < y1; j++) {
+        const char *elem = src->elems + (size_t)j * src->stride
+                           + (size_t)x0 * size;
+        for (i = x0; i < x1; i++) {
+            /* [di, dj] is where source element [i, j] lands */
+            int di = j, dj = i;
+            if (r->how == ROTATE90) di = src->height - 1 - j;
+            else if (r->how == ROTATE270) dj = src->width - 1 - i;
+            copy_elem(dst->elems + (size_t)dj * dst->stride
+                      + (size_t)di * size, elem, size);
+            elem += size;
+        }
+    }
+}
+
+/* Purpose: mirror makes a copy of a UArray2_T flipped left to right, top to
+ *          bottom, or both (a 180 degree rotation). Rows stay rows, so both
+ *          sides are walked sequentially and no tiling is needed
+ * I: An existing and initialized UArray2_T object and whether to flip each
+ *    axis
+ * O: A new width x height UArray2_T
+ */
+static UArray2_T mirror(UArray2_T uarray2, int flip_x, int flip_y)
+{
+    assert(uarray2);
+    UArray2_T dst = UArray2_new(uarray2->width, uarray2->height,
+                                uarray2->size);
+    int size = uarray2->size;
+    int i, j;
+    for (j = 0; j < uarray2->height; j++) {
+        const char *from = uarray2->elems + (size_t)j * uarray2->stride;
+        char *to = dst->elems + (size_t)(flip_y ? uarray2->height - 1 - j : j)
+                   * dst->stride;
+        if (!flip_x) {
+            memcpy(to, from, (size_t)uarray2->width * size);
+            continue;
+        }
+        to += (size_t)(uarray2->width - 1) * size;
+        for (i = 0; i < uarray2->width; i++) {
+            copy_elem(to, from, size);
+            from += size;
+            to -= size;
+        }
+    }
+    return dst;
+}
+
+/* Purpose: map_par runs every band of a parallel map on the shared pool and
+ *          then folds the worker closures into the first one
+ * I: A filled in band_job and a reduce function (or NULL)
+ * O: N/A
+ */
+static void map_par(struct band_job *job,
+                    void reduce(void *cl, void *worker_cl))
+{
+    int k;
+    advise(job->uarray2, job->by_col ? POSIX_MADV_RANDOM
+                                     : POSIX_MADV_SEQUENTIAL);
+    Pool_run(Pool_shared(job->nbands), job->nbands, map_band, job);
+    if (reduce != NULL && job->cls != NULL)
+        for (k = 1; k < job->nbands; k++)
+            reduce(job->cls[0], job->cls[k]);
+}
+
+/* Purpose: map_band is the pool task for one band of a parallel map. Band k
+ *          covers rows (or columns) [k * n / nbands, (k + 1) * n / nbands)
+ * I: The band number and a void pointer to the band_job
+ * O: N/A
+ */
+static void map_band(int k, void *cl)
+{
+    struct band_job *job = cl;
+    UArray2_T uarray2 = job->uarray2;
+    void *worker_cl = job->cls != NULL ? job->cls[k] : NULL;
+    size_t size = uarray2->size;
+    size_t stride = uarray2->stride;
+    int i, j;
+
+    if (!job->by_col) {
+        int first = (long)k * uarray2->height / job->nbands;
+        int last = (long)(k + 1) * uarray2->height / job->nbands;
+        for (j = first; j < last; j++) {
+            char *elem = uarray2->elems + j * stride;
+            for (i = 0; i < uarray2->width; i++) {
+                job->apply(i, j, uarray2, elem, worker_cl);
+                elem += size;
+            }
+        }
+    } else {
+        int first = (long)k * uarray2->width / job->nbands;
+        int last = (long)(k + 1) * uarray2->width / job->nbands;
+        for (i = first; i < last; i++) {
+            char *elem = uarray2->elems + i * size;
+            for (j = 0; j < uarray2->height; j++) {
+                job->apply(i, j, uarray2, elem, worker_cl);
+                elem += stride;
+            }
+        }
+    }
+}
+
+/* Purpose: advise tells the kernel how a file-backed array is about to be
+ *          traversed, so it can read ahead for row-major scans and skip
+ *          useless read-ahead for column-major ones. Other arrays are left
+ *          alone
+ * I: An existing and initialized UArray2_T object and a POSIX_MADV_ value
+ * O: N/A
+ */
+static void advise(UArray2_T uarray2, int advice)
+{
+    if (uarray2->owner == UARRAY2_MAPPED && uarray2->map_len > 0)
+        posix_madvise(uarray2->map, uarray2->map_len, advice);
+}
+
+/* Purpose: elem_align returns the alignment elements of a given size need:
+ *          the largest power of two dividing the size, but no more than
+ *          UARRAY2_MAX_ELEM_ALIGN
+ * I: A positive element size
+ * O: The alignment in bytes
+ */
+static size_t elem_align(int size)
+{
+    size_t align = (size_t)size & -(size_t)size;
+    return align < UARRAY2_MAX_ELEM_ALIGN ? align : UARRAY2_MAX_ELEM_ALIGN;
+}
@@ -12,35 +12,108 @@
 
 #ifndef UARRAY2_INCLUDED
 #define UARRAY2_INCLUDED
-#include "uarray.h"
 #include "assert.h"
+#include "arena.h"
 
 #define T UArray2_T
 typedef struct T *T;
 
-/* Each UArray2_T contains a UArray_T object. This UArray_T can contain
- * UArray_T objects to form a 2D array of UArray_T objects
+/* where the storage of a UArray2_T came from, which decides what
+ * UArray2_free releases
+ */
+enum UArray2_owner {
+    UARRAY2_HEAP,       /* struct and elements malloc'd by UArray2_new */
+    UARRAY2_ARENA,      /* struct and elements live in an Arena_T */
+    UARRAY2_WRAPPED,    /* elements belong to the caller */
+    UARRAY2_MAPPED,     /* elements are an mmap'd file, see UArray2_map_file */
+    UARRAY2_VIEW        /* a window onto another array, see UArray2_view */
+};
+
+/* flags for UArray2_map_file */
+#define UARRAY2_CREATE 1    /* create (or truncate) the file */
+#define UARRAY2_RDONLY 2    /* map read-only; writing an element faults */
+
+/* Each UArray2_T stores all of its elements in one contiguous, cache-line
+ * aligned block in row-major order, so element [i, j] lives at byte offset
+ * j * stride + i * size from elems. stride is width * size except in a view,
+ * which keeps the stride of the array it looks into
  */
 struct T {
     int width;
     int height;
     int size;
-    UArray_T rowArray;
+    int stride;         /* bytes from the start of one row to the next */
+    char *elems;
+    enum UArray2_owner owner;
+    void *map;          /* start and length of the mapping if MAPPED */
+    size_t map_len;
 };
 
 /* exported functions */
 
 /* Purpose: UArray2_new instantiates a UArray2_T object, allocates adequate
  *          memory for it, and initializes the struct variables using
- *          the parameters and the Ramsey/Hanson UArray_T function
+ *          the parameters. All elements are zeroed
  * I: Two nonnegative integer values representing the width and
  *    height of the 2D uarray.
  * O: A UArray2_T object
  */
 T UArray2_new(int row, int col, int size);
 
-/* Purpose: UArray2_free frees memory allocated for the UArray2_T's rowArray
- *          varaible
+/* Purpose: UArray2_new_in is UArray2_new with the UArray2_T and its
+ *          elements allocated from an arena, so that many short-lived
+ *          arrays cost one allocation each and can all be released at once
+ *          with Arena_free(arena). UArray2_free on such an array only clears
+ *          the caller's pointer
+ * I: An existing Arena_T, and the width, height, and element size as for
+ *    UArray2_new
+ * O: A UArray2_T object that lives as long as the arena's current contents
+ */
+T UArray2_new_in(Arena_T arena, int row, int col, int size);
+
+/* Purpose: UArray2_wrap makes a UArray2_T over a caller-owned buffer
+ *          without copying it. The buffer holds the elements in row-major
+ *          order (width * height * size bytes) and keeps its contents, so it
+ *          can be preallocated, huge-page, or shared memory. UArray2_free
+ *          frees the UArray2_T but never the buffer
+ * I: A nonnull buffer of at least width * height * size bytes aligned for
+ *    the element type, and the width, height, and element size
+ * O: A UArray2_T object whose elements are the buffer
+ */
+T UArray2_wrap(void *elems, int row, int col, int size);
+
+/* Purpose: UArray2_map_file makes a UArray2_T backed by a memory-mapped
+ *          file, so arrays larger than physical memory are paged in and out
+ *          by the kernel's page cache instead of being read or written
+ *          explicitly. Reopening a file costs one header check. The map
+ *          functions advise the kernel of their access pattern (sequential
+ *          for row-major, random for column-major)
+ *
+ *          File layout, in host byte order:
+ *              bytes  0-7   magic "UARRAY2" followed by a NUL
+ *              bytes  8-11  uint32 version, currently 1
+ *              bytes 12-15  uint32 offset of the elements, currently 64
+ *              bytes 16-27  int32 width, height, and element size
+ *              bytes 28-63  zero
+ *              bytes 64-    the elements in row-major order, as in memory
+ *
+ * I: A path, the width, height, and element size, and flags. With
+ *    UARRAY2_CREATE the file is created (or truncated) with all elements
+ *    zero. Without it the file must already exist; width, height, and size
+ *    must then match its header, or be 0 to accept the file's own values.
+ *    UARRAY2_RDONLY maps the file read-only. UArray2_free unmaps the file;
+ *    changes reach the file through the page cache
+ * O: A UArray2_T object, or NULL (with errno set) if the file cannot be
+ *    created, opened, or mapped, or its header does not match or is bad:
+ *    a row wider than INT_MAX bytes, or an offset not aligned for the
+ *    element size
+ */
+T UArray2_map_file(const char *path, int width, int height, int size,
+                   int flags);
+
+/* Purpose: UArray2_free frees memory allocated for the UArray2_T and, if
+ *          UArray2_new allocated them, its elements. A file-backed array is
+ *          unmapped
  * I: A nonnull pointer to a UArray2_T object
  * O: N/A
  */
@@ -75,6 +148,41 @@ int UArray2_size(T uarray2);
  */
 void *UArray2_at(T uarray2, int i, int j);
 
+/* Purpose: UArray2_row returns a pointer to the first element of row j.
+ *          The row's elements are contiguous, so element [i, j] is at byte
+ *          offset i * size from it, and callers can run their own loop
+ *          over the row without a call or bounds check per element
+ * I: An existing and initialized UArray2_T object, a row number j that is
+ *    nonnegative and less than the height, and a pointer that receives the
+ *    number of elements in the row (may be NULL)
+ * O: A void pointer to element [0, j]
+ */
+void *UArray2_row(T uarray2, int j, int *len);
+
+/* Purpose: UArray2_view returns a window onto the w x h rectangle of a
+ *          UArray2_T whose top left element is [x, y]. Element [i, j] of the
+ *          view is element [x + i, y + j] of the array, so writes through
+ *          the view change the array. A view is returned by value, owns
+ *          nothing, and never allocates; pass its address to any UArray2
+ *          function (including UArray2_view) except UArray2_free
+ * I: An existing and initialized UArray2_T object (or view), and a
+ *    rectangle that lies inside it
+ * O: A struct UArray2_T describing the window
+ */
+struct T UArray2_view(T uarray2, int x, int y, int w, int h);
+
+/* Purpose: UArray2_map_rows applies a certain function to every row of a
+ *          given UArray2_T object, top to bottom, handing it the whole row
+ *          at once as a pointer and a length
+ * I: An existing and initailized UArray2_T object, an apply function that
+ *    takes in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void UArray2_map_rows(T uarray2,
+                      void apply(int j, T uarray2, void *row, int len,
+                      void *cl), void *cl);
+
 /* Purpose: UArray2_map_row_major applies a certain function to all of the
  *          elements within a given UArray2_T object, iterating through the
  *          object one row at a time.
@@ -99,6 +207,94 @@ void UArray2_map_col_major(T uarray2,
                            void apply(int i, int j, T uarray2, void *elem, 
                            void *cl), void *cl);
 
+/* Purpose: UArray2_map_row_major_par applies a certain function to all of
+ *          the elements within a given UArray2_T object on nthreads threads
+ *          from the shared Pool_T. The rows are split into nthreads bands of
+ *          consecutive rows and band k is visited in row-major order with
+ *          cls[k] as its closure, so workers never share a closure. Once
+ *          every band is done, reduce (if not NULL) is called as
+ *          reduce(cls[0], cls[k]) for k = 1 .. nthreads - 1 in that order to
+ *          merge the results into cls[0]. apply may only write the element
+ *          it is given
+ * I: An existing and initialized UArray2_T object, an apply function that
+ *    takes in the parameters specified below, an array of nthreads closures
+ *    (or NULL, in which case every worker gets NULL), a positive number of
+ *    threads, and a reduce function (or NULL)
+ * O: N/A
+ */
+void UArray2_map_row_major_par(T uarray2,
+                               void apply(int i, int j, T uarray2, void *elem,
+                               void *cl), void *cls[], int nthreads,
+                               void reduce(void *cl, void *worker_cl));
+
+/* Purpose: UArray2_map_col_major_par is UArray2_map_row_major_par with the
+ *          array split into bands of consecutive columns, each visited in
+ *          column-major order
+ * I: An existing and initialized UArray2_T object, an apply function that
+ *    takes in the parameters specified below, an array of nthreads closures
+ *    (or NULL, in which case every worker gets NULL), a positive number of
+ *    threads, and a reduce function (or NULL)
+ * O: N/A
+ */
+void UArray2_map_col_major_par(T uarray2,
+                               void apply(int i, int j, T uarray2, void *elem,
+                               void *cl), void *cls[], int nthreads,
+                               void reduce(void *cl, void *worker_cl));
+
+
+/* Purpose: UArray2_transpose returns a new UArray2_T holding the transpose
+ *          of a given one: element [i, j] of the source is element [j, i]
+ *          of the result. The copy recursively splits the source into
+ *          tiles small enough to stay in cache on both sides, whatever the
+ *          cache size, so it avoids the cache misses of a per-element copy
+ *          that strides through the destination
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new height x width UArray2_T, freed with UArray2_free
+ */
+T UArray2_transpose(T uarray2);
+
+/* Purpose: UArray2_rotate90 returns a new UArray2_T holding a given one
+ *          rotated 90 degrees clockwise, so element [i, j] of the source is
+ *          element [height - 1 - j, i] of the result. It uses the same
+ *          cache-oblivious tiling as UArray2_transpose
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new height x width UArray2_T, freed with UArray2_free
+ */
+T UArray2_rotate90(T uarray2);
+
+/* Purpose: UArray2_rotate180 returns a new UArray2_T holding a given one
+ *          rotated 180 degrees, so element [i, j] of the source is element
+ *          [width - 1 - i, height - 1 - j] of the result
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new width x height UArray2_T, freed with UArray2_free
+ */
+T UArray2_rotate180(T uarray2);
+
+/* Purpose: UArray2_rotate270 returns a new UArray2_T holding a given one
+ *          rotated 270 degrees clockwise, so element [i, j] of the source is
+ *          element [j, width - 1 - i] of the result. It uses the same
+ *          cache-oblivious tiling as UArray2_transpose
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new height x width UArray2_T, freed with UArray2_free
+ */
+T UArray2_rotate270(T uarray2);
+
+/* Purpose: UArray2_flip_horizontal returns a new UArray2_T holding a given
+ *          one mirrored left to right, so element [i, j] of the source is
+ *          element [width - 1 - i, j] of the result
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new width x height UArray2_T, freed with UArray2_free
+ */
+T UArray2_flip_horizontal(T uarray2);
+
+/* Purpose: UArray2_flip_vertical returns a new UArray2_T holding a given
+ *          one mirrored top to bottom, so element [i, j] of the source is
+ *          element [i, height - 1 - j] of the result
+ * I: An existing and initialized UArray2_T object (or view)
+ * O: A new width x height UArray2_T, freed with UArray2_free
+ */
+T UArray2_flip_vertical(T uarray2);
+
 
 #undef T
 #endif
@@ -0,0 +1,281 @@
+/*
+ *      uarray2_bench.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This program times the UArray2_T traversals (both map functions,
+ *      map_rows, the inline UArray2_int map, and direct UArray2_at loops in
+ *      both orders), UArray2_transpose against a naive UArray2_at copy, and
+ *      the UArray2b_T map functions on a large grid and prints the cost per
+ *      element, so changes
+ *      to the uarray2.c and uarray2b.c layouts can be compared before and
+ *      after. It then times the parallel map functions on 1 .. threads
+ *      threads (default: one per processor) to show how they scale, and
+ *      prints the peak memory of the process.
+ *
+ *      Usage: uarray2_bench [width height [size [threads]]]
+ */
+
+#define _POSIX_C_SOURCE 199309L  /* for clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "uarray2.h"
+#include "uarray2b.h"
+#include "uarray2_typed.h"
+#include "pool.h"
+#include "assert.h"
+
+/* * * * * * * * * * * * * * Function Declarations * * * * * * * * * * * * * */
+double now(void);
+void report(const char *name, double seconds, long cells);
+void touch(int i, int j, UArray2_T uarray2, void *elem, void *cl);
+void touch_row(int j, UArray2_T uarray2, void *row, int len, void *cl);
+static void touch_int(int i, int j, int *elem, void *cl);
+void touch_blocked(int i, int j, UArray2b_T uarray2b, void *elem, void *cl);
+void add_sums(void *cl, void *worker_cl);
+void scaling(UArray2_T uarray2, int maxthreads, long *sum);
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int main(int argc, char *argv[])
+{
+    int width = 4000, height = 4000, size = sizeof(int);
+    int maxthreads = Pool_ncpus();
+    if (argc >= 3) {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    if (argc >= 4) size = atoi(argv[3]);
+    if (argc >= 5) maxthreads = atoi(argv[4]);
+    if (width <= 0 || height <= 0 || size < (int)sizeof(int)
+        || maxthreads <= 0) {
+        fprintf(stderr, "usage: %s [width height [size >= %d [threads]]]\n",
+                argv[0], (int)sizeof(int));
+        exit(EXIT_FAILURE);
+    }
+
+    long cells = (long)width * height;
+    long sum = 0;
+    int i, j;
+    double start;
+
+    printf("uarray2 %d x %d, %d-byte elements\n", width, height, size);
+
+    start = now();
+    UArray2_T uarray2 = UArray2_new(width, height, size);
+    report("new", now() - start, cells);
+
+    start = now();
+    UArray2_map_row_major(uarray2, touch, &sum);
+    report("map_row_major", now() - start, cells);
+
+    start = now();
+    UArray2_map_col_major(uarray2, touch, &sum);
+    report("map_col_major", now() - start, cells);
+
+    start = now();
+    UArray2_map_rows(uarray2, touch_row, &sum);
+    report("map_rows", now() - start, cells);
+
+    if (size == sizeof(int)) {
+        start = now();
+        UArray2_int_map_row_major(UArray2_int_wrap(uarray2), touch_int,
+                                  &sum);
+        report("int_map_row", now() - start, cells);
+    }
+
+    /* direct access loops, the pattern the map functions replace */
+    start = now();
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            sum += *(int *)UArray2_at(uarray2, i, j);
+    report("at_row_order", now() - start, cells);
+
+    start = now();
+    for (i = 0; i < width; i++)
+        for (j = 0; j < height; j++)
+            sum += *(int *)UArray2_at(uarray2, i, j);
+    report("at_col_order", now() - start, cells);
+
+    start = now();
+    UArray2_T naive = UArray2_new(height, width, size);
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            memcpy(UArray2_at(naive, j, i), UArray2_at(uarray2, i, j), size);
+    report("naive_transpose", now() - start, cells);
+
+    start = now();
+    UArray2_T transposed = UArray2_transpose(uarray2);
+    report("transpose", now() - start, cells);
+    sum += memcmp(UArray2_at(naive, height - 1, width - 1),
+                  UArray2_at(transposed, height - 1, width - 1), size);
+    UArray2_free(&transposed);
+    UArray2_free(&naive);
+
+    scaling(uarray2, maxthreads, &sum);
+
+    start = now();
+    UArray2_free(&uarray2);
+    report("free", now() - start, cells);
+
+    UArray2b_T uarray2b = UArray2b_new_64K_block(width, height, size);
+    printf("uarray2b blocksize %d\n", UArray2b_blocksize(uarray2b));
+
+    start = now();
+    UArray2b_map_row_major(uarray2b, touch_blocked, &sum);
+    report("b_map_row_major", now() - start, cells);
+
+    start = now();
+    UArray2b_map_col_major(uarray2b, touch_blocked, &sum);
+    report("b_map_col_major", now() - start, cells);
+
+    start = now();
+    UArray2b_map_block_major(uarray2b, touch_blocked, &sum);
+    report("b_map_blk_major", now() - start, cells);
+
+    UArray2b_free(&uarray2b);
+
+    /* printing the checksum keeps the loops from being optimized away */
+    printf("checksum %ld\n", sum);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        printf("peak rss %ld kB\n", usage.ru_maxrss);
+    exit(EXIT_SUCCESS);
+}
+
+/* Purpose: scaling times both parallel map functions on every thread count
+ *          from 1 to maxthreads and prints the speedup over one thread
+ * I: An existing and initialized UArray2_T object, the largest number of
+ *    threads to try, and a pointer to the running checksum
+ * O: N/A
+ */
+void scaling(UArray2_T uarray2, int maxthreads, long *sum)
+{
+    long cells = (long)UArray2_width(uarray2) * UArray2_height(uarray2);
+    long *sums = (long *)malloc(maxthreads * sizeof(long));
+    void **cls = (void **)malloc(maxthreads * sizeof(void *));
+    double row_one = 0, col_one = 0;
+    int n, k;
+    assert(sums && cls);
+
+    for (n = 1; n <= maxthreads; n++) {
+        double start, row, col;
+        for (k = 0; k < n; k++) {
+            sums[k] = 0;
+            cls[k] = &sums[k];
+        }
+        start = now();
+        UArray2_map_row_major_par(uarray2, touch, cls, n, add_sums);
+        row = now() - start;
+        *sum += sums[0];
+
+        for (k = 0; k < n; k++) sums[k] = 0;
+        start = now();
+        UArray2_map_col_major_par(uarray2, touch, cls, n, add_sums);
+        col = now() - start;
+        *sum += sums[0];
+
+        if (n == 1) {
+            row_one = row;
+            col_one = col;
+        }
+        printf("threads %-3d row_par %8.3f ns/elem x%.2f  "
+               "col_par %8.3f ns/elem x%.2f\n", n, row * 1e9 / cells,
+               row_one / row, col * 1e9 / cells, col_one / col);
+    }
+    free(cls);
+    free(sums);
+}
+
+/* Purpose: add_sums is the reduce function for the parallel maps
+ * I: Pointers to the checksum being merged into and a worker's checksum
+ * O: N/A
+ */
+void add_sums(void *cl, void *worker_cl)
+{
+    *(long *)cl += *(long *)worker_cl;
+}
+
+/* Purpose: now returns the current time of a monotonic clock
+ * I: N/A
+ * O: The current time in seconds
+ */
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Purpose: report prints one timing line
+ * I: The name of the case, the time it took in seconds, and the number of
+ *    elements it covered
+ * O: N/A
+ */
+void report(const char *name, double seconds, long cells)
+{
+    printf("%-16s %10.3f ms %8.3f ns/elem\n", name, seconds * 1e3,
+           seconds * 1e9 / cells);
+}
+
+/* Purpose: touch is the apply function for both map functions. It reads
+ *          and bumps each element so every visit costs a load and a store
+ * I: A position represented by [i, j], the UArray2_T being mapped, a pointer
+ *    to the element, and a pointer to a running checksum
+ * O: N/A
+ */
+void touch(int i, int j, UArray2_T uarray2, void *elem, void *cl)
+{
+    (void) i;
+    (void) j;
+    (void) uarray2;
+    *(long *)cl += (*(int *)elem)++;
+}
+
+/* Purpose: touch_row is the map_rows version of touch; the loop over the
+ *          row is the caller's own, so the compiler can vectorize it
+ * I: A row number, the UArray2_T being mapped, a pointer to the first
+ *    element of the row and its length, and a pointer to a running checksum
+ * O: N/A
+ */
+void touch_row(int j, UArray2_T uarray2, void *row, int len, void *cl)
+{
+    (void) j;
+    (void) uarray2;
+    int *elems = row;
+    long sum = 0;
+    int i;
+    for (i = 0; i < len; i++) sum += elems[i]++;
+    *(long *)cl += sum;
+}
+
+/* Purpose: touch_int is the UArray2_int version of touch. It is static so
+ *          the compiler can inline it into UArray2_int_map_row_major
+ * I: A position represented by [i, j], a pointer to the element, and a
+ *    pointer to a running checksum
+ * O: N/A
+ */
+static void touch_int(int i, int j, int *elem, void *cl)
+{
+    (void) i;
+    (void) j;
+    *(long *)cl += (*elem)++;
+}
+
+/* Purpose: touch_blocked is the UArray2b_T version of touch
+ * I: A position represented by [i, j], the UArray2b_T being mapped, a
+ *    pointer to the element, and a pointer to a running checksum
+ * O: N/A
+ */
+void touch_blocked(int i, int j, UArray2b_T uarray2b, void *elem, void *cl)
+{
+    (void) i;
+    (void) j;
+    (void) uarray2b;
+    *(long *)cl += (*(int *)elem)++;
+}
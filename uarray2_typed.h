@@ -0,0 +1,116 @@
+/*
+ *      uarray2_typed.h
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This header generates typed versions of UArray2_T whose accessors
+ *      and map functions are static inline and know the element type at
+ *      compile time, so the compiler can inline and vectorize them instead
+ *      of going through UArray2_at and a void *. The bounds checks are
+ *      asserts, so they stay in debug builds and vanish with -DNDEBUG,
+ *      which "make release" passes; the default build keeps them
+ *
+ *      UARRAY2_TYPED(NAME, TYPE) declares type NAME and the functions
+ *      NAME_new, NAME_wrap, NAME_free, NAME_at, NAME_get, NAME_put,
+ *      NAME_map_row_major and NAME_map_col_major. UArray2_int, UArray2_u8,
+ *      UArray2_float and UArray2_double are generated below. Each NAME is
+ *      its own struct holding a UArray2_T of size sizeof(TYPE) as base, so
+ *      passing one typed array where another is expected does not compile,
+ *      and base can still be passed to every function in uarray2.h
+ */
+
+#ifndef UARRAY2_TYPED_INCLUDED
+#define UARRAY2_TYPED_INCLUDED
+#include <stddef.h>
+#include "uarray2.h"
+#include "assert.h"
+
+#define UARRAY2_TYPED(NAME, TYPE)                                             \
+typedef struct {                                                              \
+    UArray2_T base;                                                           \
+} NAME;                                                                       \
+                                                                              \
+/* Purpose: NAME##_new makes a UArray2_T of TYPE elements, all zero */        \
+static inline NAME NAME##_new(int width, int height)                          \
+{                                                                             \
+    NAME uarray2 = { UArray2_new(width, height, sizeof(TYPE)) };              \
+    return uarray2;                                                           \
+}                                                                             \
+                                                                              \
+/* Purpose: NAME##_wrap views a UArray2_T of TYPE elements as a NAME */       \
+static inline NAME NAME##_wrap(UArray2_T base)                                \
+{                                                                             \
+    assert(base && base->size == (int)sizeof(TYPE));                          \
+    NAME uarray2 = { base };                                                  \
+    return uarray2;                                                           \
+}                                                                             \
+                                                                              \
+/* Purpose: NAME##_free frees a NAME made by NAME##_new */                    \
+static inline void NAME##_free(NAME *uarray2)                                 \
+{                                                                             \
+    assert(uarray2);                                                          \
+    UArray2_free(&uarray2->base);                                             \
+}                                                                             \
+                                                                              \
+/* Purpose: NAME##_at returns a pointer to element [i, j] */                  \
+static inline TYPE *NAME##_at(NAME uarray2, int i, int j)                     \
+{                                                                             \
+    UArray2_T base = uarray2.base;                                            \
+    assert(base && base->size == (int)sizeof(TYPE));                          \
+    assert(i >= 0 && i < base->width);                                        \
+    assert(j >= 0 && j < base->height);                                       \
+    return (TYPE *)(base->elems + (size_t)j * base->stride) + i;              \
+}                                                                             \
+                                                                              \
+/* Purpose: NAME##_get returns the value of element [i, j] */                 \
+static inline TYPE NAME##_get(NAME uarray2, int i, int j)                     \
+{                                                                             \
+    return *NAME##_at(uarray2, i, j);                                         \
+}                                                                             \
+                                                                              \
+/* Purpose: NAME##_put stores value in element [i, j] */                      \
+static inline void NAME##_put(NAME uarray2, int i, int j, TYPE value)         \
+{                                                                             \
+    *NAME##_at(uarray2, i, j) = value;                                        \
+}                                                                             \
+                                                                              \
+/* Purpose: NAME##_map_row_major calls apply on every element, one row at a   \
+ *          time, in storage order                                            \
+ */                                                                           \
+static inline void NAME##_map_row_major(NAME uarray2,                         \
+                                        void apply(int i, int j, TYPE *elem,  \
+                                        void *cl), void *cl)                  \
+{                                                                             \
+    UArray2_T base = uarray2.base;                                            \
+    assert(base && base->size == (int)sizeof(TYPE));                          \
+    int i, j;                                                                 \
+    for (j = 0; j < base->height; j++) {                                      \
+        TYPE *row = (TYPE *)(base->elems + (size_t)j * base->stride);         \
+        for (i = 0; i < base->width; i++)                                     \
+            apply(i, j, &row[i], cl);                                         \
+    }                                                                         \
+}                                                                             \
+                                                                              \
+/* Purpose: NAME##_map_col_major calls apply on every element, one column at  \
+ *          a time                                                            \
+ */                                                                           \
+static inline void NAME##_map_col_major(NAME uarray2,                         \
+                                        void apply(int i, int j, TYPE *elem,  \
+                                        void *cl), void *cl)                  \
+{                                                                             \
+    UArray2_T base = uarray2.base;                                            \
+    assert(base && base->size == (int)sizeof(TYPE));                          \
+    size_t stride = base->stride;                                             \
+    int i, j;                                                                 \
+    for (i = 0; i < base->width; i++)                                         \
+        for (j = 0; j < base->height; j++)                                    \
+            apply(i, j, (TYPE *)(base->elems + j * stride) + i, cl);          \
+}
+
+UARRAY2_TYPED(UArray2_int, int)
+UARRAY2_TYPED(UArray2_u8, unsigned char)
+UARRAY2_TYPED(UArray2_float, float)
+UARRAY2_TYPED(UArray2_double, double)
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ *      uarray2b.c
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code includes the function definitions for all the functions
+ *      declared in uarray2b.h
+ */
+
+#define _POSIX_C_SOURCE 200112L  /* for posix_memalign */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "uarray2b.h"
+
+/* alignment of the element block; one cache line on the machines we use */
+#define UARRAY2B_ALIGN 64
+
+/* largest number of bytes UArray2b_new_64K_block puts in one block */
+#define UARRAY2B_TARGET (64 * 1024)
+
+/* Purpose: block_at returns a pointer to the first cell of the block in
+ *          block column bi and block row bj
+ * I: An existing and initialized UArray2b_T object and the block position
+ * O: A pointer to the first byte of the block
+ */
+static inline char *block_at(UArray2b_T uarray2b, int bi, int bj)
+{
+    size_t block_bytes = (size_t)uarray2b->blocksize * uarray2b->blocksize
+                         * uarray2b->size;
+    return uarray2b->elems
+           + ((size_t)bj * uarray2b->blocks_wide + bi) * block_bytes;
+}
+
+/* Purpose: UArray2b_new instantiates a UArray2b_T object whose blocks hold
+ *          blocksize * blocksize cells each. All elements are zeroed
+ * I: Two nonnegative integer values representing the width and height of
+ *    the array, a positive element size in bytes, and a positive block size
+ * O: A UArray2b_T object
+ */
+UArray2b_T UArray2b_new(int width, int height, int size, int blocksize)
+{
+    assert(width >= 0 && height >= 0);
+    assert(size > 0 && blocksize > 0);
+    UArray2b_T uarray2b = (UArray2b_T)malloc(sizeof(*uarray2b));
+    assert(uarray2b);
+
+    uarray2b->width = width;
+    uarray2b->height = height;
+    uarray2b->size = size;
+    uarray2b->blocksize = blocksize;
+    uarray2b->blocks_wide = (width + blocksize - 1) / blocksize;
+
+    /* edge blocks are allocated in full so every block has the same size
+     * and the position of a block is a single multiply
+     */
+    int blocks_high = (height + blocksize - 1) / blocksize;
+    size_t nbytes = (size_t)uarray2b->blocks_wide * blocks_high
+                    * blocksize * blocksize * size;
+    void *elems = NULL;
+    if (posix_memalign(&elems, UARRAY2B_ALIGN,
+                       nbytes > 0 ? nbytes : UARRAY2B_ALIGN) != 0)
+        elems = NULL;
+    assert(elems);
+    memset(elems, 0, nbytes);
+    uarray2b->elems = elems;
+
+    return uarray2b;
+}
+
+/* Purpose: UArray2b_new_64K_block instantiates a UArray2b_T object with the
+ *          largest block size whose block still fits in 64KB, so that one
+ *          block stays resident in a typical L2 cache. If one element is
+ *          larger than 64KB the block size is 1
+ * I: Two nonnegative integer values representing the width and height of
+ *    the array, and a positive element size in bytes
+ * O: A UArray2b_T object
+ */
+UArray2b_T UArray2b_new_64K_block(int width, int height, int size)
+{
+    assert(size > 0);
+    long blocksize = 1;
+    while ((blocksize + 1) * (blocksize + 1) * size <= UARRAY2B_TARGET)
+        blocksize++;
+    return UArray2b_new(width, height, size, blocksize);
+}
+
+/* Purpose: UArray2b_free frees memory allocated for the UArray2b_T and its
+ *          elements
+ * I: A nonnull pointer to a UArray2b_T object
+ * O: N/A
+ */
+void UArray2b_free(UArray2b_T *uarray2b)
+{
+    assert(uarray2b && *uarray2b);
+    free((*uarray2b)->elems);
+    free(*uarray2b);
+    *uarray2b = NULL;
+}
+
+/* Purpose: UArray2b_width returns the width of a given UArray2b_T
+ * I: An existing and initialized UArray2b_T object
+ * O: An integer representing the UArray2b_T's width variable
+ */
+int UArray2b_width(UArray2b_T uarray2b)
+{
+    assert(uarray2b);
+    return uarray2b->width;
+}
+
+/* Purpose: UArray2b_height returns the height of a given UArray2b_T
+ * I: An existing and initialized UArray2b_T object
+ * O: An integer representing the UArray2b_T's height variable
+ */
+int UArray2b_height(UArray2b_T uarray2b)
+{
+    assert(uarray2b);
+    return uarray2b->height;
+}
+
+/* Purpose: UArray2b_size returns the size of an element in a given
+ *          UArray2b_T
+ * I: An existing and initialized UArray2b_T object
+ * O: An integer representing the UArray2b_T's size variable
+ */
+int UArray2b_size(UArray2b_T uarray2b)
+{
+    assert(uarray2b);
+    return uarray2b->size;
+}
+
+/* Purpose: UArray2b_blocksize returns the number of cells on one side of a
+ *          block in a given UArray2b_T
+ * I: An existing and initialized UArray2b_T object
+ * O: An integer representing the UArray2b_T's blocksize variable
+ */
+int UArray2b_blocksize(UArray2b_T uarray2b)
+{
+    assert(uarray2b);
+    return uarray2b->blocksize;
+}
+
+/* Purpose: UArray2b_at returns a pointer to the element located at
+ *          position [i, j] in a given UArray2b_T
+ * I: An existing and initialized UArray2b_T object, and position variables
+ *    i and j, which are nonnegative and less than the width and height of
+ *    the given UArray2b_T respectively
+ * O: A void pointer that points to the element at position [i, j]
+ */
+void *UArray2b_at(UArray2b_T uarray2b, int i, int j)
+{
+    assert(uarray2b);
+    assert(i >= 0 && j >= 0);
+    assert(i < uarray2b->width && j < uarray2b->height);
+    int b = uarray2b->blocksize;
+    return block_at(uarray2b, i / b, j / b)
+           + ((size_t)(j % b) * b + (i % b)) * uarray2b->size;
+}
+
+/* Purpose: UArray2b_map_row_major applies a certain function to all of the
+ *          elements within a given UArray2b_T object, iterating through the
+ *          object one row at a time.
+ * I: An existing and initialized UArray2b_T object, an apply function that
+ *    takes in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void UArray2b_map_row_major(UArray2b_T uarray2b,
+                            void apply(int i, int j, UArray2b_T uarray2b,
+                            void *elem, void *cl), void *cl)
+{
+    assert(uarray2b);
+    int b = uarray2b->blocksize;
+    int size = uarray2b->size;
+    int i, j, bi;
+    for (j = 0; j < uarray2b->height; j++) {
+        /* each row is a run of blocksize contiguous cells in every block
+         * along this row of blocks
+         */
+        for (bi = 0; bi < uarray2b->blocks_wide; bi++) {
+            char *elem = block_at(uarray2b, bi, j / b)
+                         + (size_t)(j % b) * b * size;
+            int end = (bi + 1) * b;
+            if (end > uarray2b->width) end = uarray2b->width;
+            for (i = bi * b; i < end; i++) {
+                apply(i, j, uarray2b, elem, cl);
+                elem += size;
+            }
+        }
+    }
+}
+
+/* Purpose: UArray2b_map_col_major applies a certain function to all of the
+ *          elements within a given UArray2b_T object, iterating through the
+ *          object one column at a time.
+ * I: An existing and initialized UArray2b_T object, an apply function that
+ *    takes in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void UArray2b_map_col_major(UArray2b_T uarray2b,
+                            void apply(int i, int j, UArray2b_T uarray2b,
+                            void *elem, void *cl), void *cl)
+{
+    assert(uarray2b);
+    int b = uarray2b->blocksize;
+    int blocks_high = (uarray2b->height + b - 1) / b;
+    size_t stride = (size_t)b * uarray2b->size;
+    int i, j, bj;
+    for (i = 0; i < uarray2b->width; i++) {
+        /* down a column the cells of one block are only blocksize cells
+         * apart, so each block's share of the column stays in cache
+         */
+        for (bj = 0; bj < blocks_high; bj++) {
+            char *elem = block_at(uarray2b, i / b, bj)
+                         + (size_t)(i % b) * uarray2b->size;
+            int end = (bj + 1) * b;
+            if (end > uarray2b->height) end = uarray2b->height;
+            for (j = bj * b; j < end; j++) {
+                apply(i, j, uarray2b, elem, cl);
+                elem += stride;
+            }
+        }
+    }
+}
+
+/* Purpose: UArray2b_map_block_major applies a certain function to all of the
+ *          elements within a given UArray2b_T object, iterating through the
+ *          object one block at a time. Blocks are visited row by row and the
+ *          cells inside a block are visited row-major, which is the order
+ *          they are stored in
+ * I: An existing and initialized UArray2b_T object, an apply function that
+ *    takes in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void UArray2b_map_block_major(UArray2b_T uarray2b,
+                              void apply(int i, int j, UArray2b_T uarray2b,
+                              void *elem, void *cl), void *cl)
+{
+    assert(uarray2b);
+    int b = uarray2b->blocksize;
+    int size = uarray2b->size;
+    int blocks_high = (uarray2b->height + b - 1) / b;
+    int i, j, bi, bj;
+    for (bj = 0; bj < blocks_high; bj++) {
+        for (bi = 0; bi < uarray2b->blocks_wide; bi++) {
+            char *block = block_at(uarray2b, bi, bj);
+            int right = (bi + 1) * b, bottom = (bj + 1) * b;
+            if (right > uarray2b->width) right = uarray2b->width;
+            if (bottom > uarray2b->height) bottom = uarray2b->height;
+
+            /* cells past the right edge are padding and are skipped */
+            for (j = bj * b; j < bottom; j++) {
+                char *elem = block + (size_t)(j - bj * b) * b * size;
+                for (i = bi * b; i < right; i++) {
+                    apply(i, j, uarray2b, elem, cl);
+                    elem += size;
+                }
+            }
+        }
+    }
+}
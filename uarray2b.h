@@ -0,0 +1,135 @@
+/*
+ *      uarray2b.h
+ *      by Lewis Bobrow and John Stewart
+ *      February 10th 2020
+ *      Assignment: HW2 (iii)
+ *
+ *      This code declares the UArray2b_T struct, a blocked 2D array, as well
+ *      as the functions associated with it. The interface mirrors uarray2.h
+ *      and adds map_block_major, which visits the array one block at a time
+ */
+
+#ifndef UARRAY2B_INCLUDED
+#define UARRAY2B_INCLUDED
+#include "assert.h"
+
+#define T UArray2b_T
+typedef struct T *T;
+
+/* Each UArray2b_T stores its elements in blocksize x blocksize blocks. The
+ * cells of a block are contiguous and stored row-major, and the blocks are
+ * themselves laid out row-major in one allocation. Blocks on the right and
+ * bottom edges are allocated in full even if the array does not cover them
+ */
+struct T {
+    int width;
+    int height;
+    int size;
+    int blocksize;
+    int blocks_wide;    /* number of blocks in one row of blocks */
+    char *elems;
+};
+
+/* exported functions */
+
+/* Purpose: UArray2b_new instantiates a UArray2b_T object whose blocks hold
+ *          blocksize * blocksize cells each. All elements are zeroed
+ * I: Two nonnegative integer values representing the width and height of
+ *    the array, a positive element size in bytes, and a positive block size
+ * O: A UArray2b_T object
+ */
+T UArray2b_new(int width, int height, int size, int blocksize);
+
+/* Purpose: UArray2b_new_64K_block instantiates a UArray2b_T object with the
+ *          largest block size whose block still fits in 64KB, so that one
+ *          block stays resident in a typical L2 cache. If one element is
+ *          larger than 64KB the block size is 1
+ * I: Two nonnegative integer values representing the width and height of
+ *    the array, and a positive element size in bytes
+ * O: A UArray2b_T object
+ */
+T UArray2b_new_64K_block(int width, int height, int size);
+
+/* Purpose: UArray2b_free frees memory allocated for the UArray2b_T and its
+ *          elements
+ * I: A nonnull pointer to a UArray2b_T object
+ * O: N/A
+ */
+void UArray2b_free(T *uarray2b);
+
+/* Purpose: UArray2b_width returns the width of a given UArray2b_T
+ * I: An existing and initialized UArray2b_T object
+ * O: An integer representing the UArray2b_T's width variable
+ */
+int UArray2b_width(T uarray2b);
+
+/* Purpose: UArray2b_height returns the height of a given UArray2b_T
+ * I: An existing and initialized UArray2b_T object
+ * O: An integer representing the UArray2b_T's height variable
+ */
+int UArray2b_height(T uarray2b);
+
+/* Purpose: UArray2b_size returns the size of an element in a given
+ *          UArray2b_T
+ * I: An existing and initialized UArray2b_T object
+ * O: An integer representing the UArray2b_T's size variable
+ */
+int UArray2b_size(T uarray2b);
+
+/* Purpose: UArray2b_blocksize returns the number of cells on one side of a
+ *          block in a given UArray2b_T
+ * I: An existing and initialized UArray2b_T object
+ * O: An integer representing the UArray2b_T's blocksize variable
+ */
+int UArray2b_blocksize(T uarray2b);
+
+/* Purpose: UArray2b_at returns a pointer to the element located at
+ *          position [i, j] in a given UArray2b_T
+ * I: An existing and initialized UArray2b_T object, and position variables
+ *    i and j, which are nonnegative and less than the width and height of
+ *    the given UArray2b_T respectively
+ * O: A void pointer that points to the element at position [i, j]
+ */
+void *UArray2b_at(T uarray2b, int i, int j);
+
+/* Purpose: UArray2b_map_row_major applies a certain function to all of the
+ *          elements within a given UArray2b_T object, iterating through the
+ *          object one row at a time.
+ * I: An existing and initialized UArray2b_T object, an apply function that
+ *    takes in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void UArray2b_map_row_major(T uarray2b,
+                            void apply(int i, int j, T uarray2b, void *elem,
+                            void *cl), void *cl);
+
+/* Purpose: UArray2b_map_col_major applies a certain function to all of the
+ *          elements within a given UArray2b_T object, iterating through the
+ *          object one column at a time.
+ * I: An existing and initialized UArray2b_T object, an apply function that
+ *    takes in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void UArray2b_map_col_major(T uarray2b,
+                            void apply(int i, int j, T uarray2b, void *elem,
+                            void *cl), void *cl);
+
+/* Purpose: UArray2b_map_block_major applies a certain function to all of the
+ *          elements within a given UArray2b_T object, iterating through the
+ *          object one block at a time. Blocks are visited row by row and the
+ *          cells inside a block are visited row-major, which is the order
+ *          they are stored in
+ * I: An existing and initialized UArray2b_T object, an apply function that
+ *    takes in the parameters specified below, a void pointer to carry certain
+ *    values over between function calls
+ * O: N/A
+ */
+void UArray2b_map_block_major(T uarray2b,
+                              void apply(int i, int j, T uarray2b, void *elem,
+                              void *cl), void *cl);
+
+
+#undef T
+#endif
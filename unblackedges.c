@@ -1,110 +1,740 @@
+#define _POSIX_C_SOURCE 200809L  /* for clock_gettime and getline */
+
 #include <stdlib.h>
 #include <stdio.h>
-#include <pnmrdr.h>
+#include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #include "bit2.h"
+#include "pbm.h"
+#include "label.h"
+#include "pool.h"
 #include "assert.h"
 
 /* Stack structure used to manage a large amount of operations.
- * Recursion results in stack overflow for very large bit maps
+ * Recursion results in stack overflow for very large bit maps. It holds
+ * the seed pixels of runs still to be filled, each as the index
+ * width * j + i, which is a long since a page can have more than INT_MAX
+ * pixels, and grows when full
  */
 struct Stack {
-    int head;
-    int max;
-    int* array;
+    long head;
+    long max;
+    long* array;
+    long peak;              /* highest head so far */
+    long pushes;
+    long pops;
+};
+
+/* The words of a row of reached pixels that changed since the next row in
+ * one sweep direction last took them in; empty when lo > hi
+ */
+struct Pending {
+    int lo;
+    int hi;
+};
+
+/* One worker of a batch, with the buffers it keeps from page to page: the
+ * storage its Bit2_T objects are wrapped around and its Stack
+ */
+struct Worker {
+    uint64_t *words;
+    long size;              /* bytes of words */
+    struct Stack* blackedges;
+    int pages;              /* pages written */
+    int failed;             /* pages that could not be read or written */
+};
+
+/* struct passed to batch_worker through Pool_run, describing one batch */
+struct Batch {
+    char **paths;
+    int npaths;
+    int next;               /* next path to be claimed, taken atomically */
+    const char *out_dir;
+    int raw;
+    struct Worker *workers;
+};
+
+/* The raster of a raw (P4) file where it lies, for --in-place: height rows
+ * of row_bytes bytes, eight pixels to a byte with the leftmost in the high
+ * bit. The bits past the width in the last byte of a row may be anything
+ */
+struct Packed {
+    unsigned char *bytes;
+    long row_bytes;
+    int width;
+    int height;
+};
+
+/* The wall clock and CPU time at a point in main, or taken by a phase */
+struct Phase {
+    double wall;
+    double cpu;
+};
+
+/* What --stats reports about one run, a phase at a time: reading the
+ * image, seeding the Stack from the border, filling, and writing
+ */
+struct Stats {
+    const char *fill;
+    int width;
+    int height;
+    struct Phase reading;
+    struct Phase seeding;
+    struct Phase filling;
+    struct Phase writing;
+    int stacked;            /* whether the fill used the Stack */
+    long seeds;             /* border seeds pushed by store_edges */
+    long pushes;
+    long pops;
+    long peak;              /* deepest the Stack got */
 };
 
 /* * * * * * * * * * * Function Declarations * * * * * * * * * * */
-void pbmread (int i, int j, Bit2_T map, int elem, void *cl);
+Bit2_T pbmread(FILE *inputfp, int throughput);
+int pbmstream(FILE *inputfp, int raw, int throughput);
+int pbmbatch(const char *list, const char *out_dir, int raw, int nthreads);
+int pbminplace(const char *path, int throughput);
+void batch_worker(int k, void *cl);
+int unblack_file(const char *path, struct Batch *batch,
+                 struct Worker *worker);
+char **read_list(const char *list, int *npaths);
+const char *out_name(const char *path);
+int same_names(char **paths, int npaths, const char *out_dir);
+int compare_names(const void *a, const void *b);
+double now(void);
+double cputime(void);
+void lap(struct Phase *phase, struct Phase *since);
+void print_stats(FILE *fp, struct Stats *stats);
 void store_edges(Bit2_T image, struct Stack* blackedges);
 void unblack_edges(Bit2_T image, struct Stack* blackedges);
-void pbmwrite(FILE *outputfp, Bit2_T bitmap);
-void translate(int i, int j, Bit2_T bit2, int elem, void *cl);
+void unblack_edges_packed(struct Packed *image, struct Stack* blackedges);
+int packed_left(const unsigned char *row, int i);
+int packed_right(const unsigned char *row, int i, int width);
+void packed_clear(unsigned char *row, int l, int r);
+void packed_seed(struct Stack* blackedges, const unsigned char *row, int j,
+                 int width, int l, int r);
+int run_left(const uint64_t *row, int i);
+int run_right(const uint64_t *row, int i, int width);
+void clear_run(uint64_t *row, int l, int r);
+void seed_runs(struct Stack* blackedges, const uint64_t *row, int j,
+               int width, int l, int r);
+int ctz64(uint64_t word);
+int clz64(uint64_t word);
+void pbmwrite(FILE *outputfp, Bit2_T bitmap, int raw);
 struct Stack* createStack(unsigned max);
 void freeStack(struct Stack *array);
-void push(struct Stack* blackedges, int elem);
-int pop(struct Stack* blackedges);
+void push(struct Stack* blackedges, long elem);
+long pop(struct Stack* blackedges);
 int isEmpty(struct Stack* blackedges);
+void unblack_edges_words(Bit2_T image);
+int sweep(Bit2_T image, Bit2_T reach, struct Pending *pending, int down);
+void close_row(uint64_t *reach, const uint64_t *black, int nwords, int *lo,
+               int *hi);
+void add_pending(struct Pending *pending, int lo, int hi);
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 int main(int argc, char *argv[])
 {
-    Pnmrdr_T reader;
-    FILE *fp;
+    FILE *fp = stdin;
+    int throughput = 0, raw = 0, nthreads = 0, stream = 0, inplace = 0;
+    int stats = 0, bad = 0;
+    const char *path = NULL, *fill = "span", *list = NULL, *out_dir = NULL;
+    int a;
 
-    /* Creating a Pnmrdr_T object from the commandline argument if it exists,
-     * otherwise create it from stdin
+    /* unblackedges [--throughput] [--raw] [--fill=span|words|tiles]
+     * [-j threads] [--stream] [file]: the image comes from the file if one
+     * is named, otherwise from stdin, and is written as P4 instead of P1
+     * with --raw. --fill picks the scanline fill (the default), the
+     * word-parallel one, or the tiled labeling in label.c, which runs on -j
+     * threads (one per processor by default). --stream reads the image
+     * twice a row at a time instead of holding it, so it needs a file.
+     * --batch names a file listing one image per line, which are written
+     * to the --out-dir directory under their own names, which must all
+     * differ, by -j workers.
+     * --in-place changes a raw (P4) file where it lies, through a shared
+     * mapping of it, and writes nothing to stdout. --stats, or
+     * UNBLACKEDGES_STATS set to anything but 0 in the environment, prints
+     * JSON to stderr with the time and counts of each phase of a run
      */
-    if (argc == 2) {
-        fp = fopen(argv[1], "r");
-        TRY
-            reader = Pnmrdr_new(fp);
-        EXCEPT(Pnmrdr_Badformat)
-            fprintf(stderr, "Image is not the correct format\n");
-            exit(EXIT_FAILURE);
-        END_TRY;
-    } else if (argc == 1) {
-        TRY
-            reader = Pnmrdr_new(stdin);
-        EXCEPT(Pnmrdr_Badformat)
-            fprintf(stderr, "Image is not the correct format\n");
+    for (a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--throughput") == 0) throughput = 1;
+        else if (strcmp(argv[a], "--raw") == 0) raw = 1;
+        else if (strcmp(argv[a], "--fill=span") == 0) fill = "span";
+        else if (strcmp(argv[a], "--fill=words") == 0) fill = "words";
+        else if (strcmp(argv[a], "--fill=tiles") == 0) fill = "tiles";
+        else if (strcmp(argv[a], "--stream") == 0) stream = 1;
+        else if (strcmp(argv[a], "--in-place") == 0) inplace = 1;
+        else if (strcmp(argv[a], "--stats") == 0) stats = 1;
+        else if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc)
+            list = argv[++a];
+        else if (strcmp(argv[a], "--out-dir") == 0 && a + 1 < argc)
+            out_dir = argv[++a];
+        else if (strcmp(argv[a], "-j") == 0 && a + 1 < argc
+                 && atoi(argv[a + 1]) > 0) nthreads = atoi(argv[++a]);
+        else if (path == NULL && argv[a][0] != '-') path = argv[a];
+        else bad = 1;
+    }
+
+    /* a batch takes no file and only the scanline fill, whose Stack the
+     * workers keep
+     */
+    if ((list == NULL) != (out_dir == NULL))
+        bad = 1;
+    if (list != NULL && (path != NULL || stream || strcmp(fill, "span") != 0))
+        bad = 1;
+
+    /* an in-place fill needs a file to map and writes no output */
+    if (inplace && (path == NULL || list != NULL || stream || raw
+                    || strcmp(fill, "span") != 0))
+        bad = 1;
+
+    /* the phases --stats times are those of a whole image in memory */
+    if (stats && (list != NULL || stream || inplace))
+        bad = 1;
+    if (bad) {
+        fprintf(stderr, "usage: %s [--throughput] [--raw] "
+                "[--fill=span|words|tiles] [-j threads] [--stream] "
+                "[--stats] [file]\n"
+                "       %s [--raw] [-j threads] --batch list --out-dir dir\n"
+                "       %s [--throughput] --in-place file\n",
+                argv[0], argv[0], argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (list != NULL) {
+        exit(pbmbatch(list, out_dir, raw, nthreads) == 0 ? EXIT_SUCCESS
+                                                         : EXIT_FAILURE);
+    }
+    if (inplace) {
+        exit(pbminplace(path, throughput) == 0 ? EXIT_SUCCESS
+                                                : EXIT_FAILURE);
+    }
+    if (path != NULL) {
+        fp = fopen(path, "rb");
+        if (fp == NULL) {
+            fprintf(stderr, "Could not open %s\n", path);
             exit(EXIT_FAILURE);
-        END_TRY;
+        }
     }
-    else exit(EXIT_FAILURE);
 
-    /* ensuring that the Pnmrdr_T object is properly formatted */
-    Pnmrdr_mapdata data = Pnmrdr_data(reader);
-    assert(data.type == Pnmrdr_bit);
-    assert(data.width != 0);
-    assert(data.height != 0);
+    /* streaming the image through label.c, never holding all of it */
+    if (stream) {
+        int status = pbmstream(fp, raw, throughput);
+        if (fp != stdin) fclose(fp);
+        exit(status == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
 
-    /* creating a Bit2_T object and initializing
-     * it with the bit values from reader
+    /* each phase is timed whether or not it is reported, which is only a
+     * few clock reads, and the Stack always keeps its counts
      */
-    Bit2_T bitmap = Bit2_new(data.width, data.height);
-    Bit2_map_row_major(bitmap, pbmread, reader);
+    const char *env = getenv("UNBLACKEDGES_STATS");
+    if (env != NULL && env[0] != '\0' && strcmp(env, "0") != 0) stats = 1;
+    struct Stats report;
+    struct Phase since;
+    memset(&report, 0, sizeof(report));
+    report.fill = fill;
+    lap(NULL, &since);
+
+    /* reading the image into a Bit2_T object */
+    Bit2_T bitmap = pbmread(fp, throughput);
+    if (bitmap == NULL) {
+        fprintf(stderr, "Image is not the correct format\n");
+        exit(EXIT_FAILURE);
+    }
+    report.width = Bit2_width(bitmap);
+    report.height = Bit2_height(bitmap);
+    lap(&report.reading, &since);
 
     /* using a stack to store all the black edge bits that need
-     * to be unblacked and then unblacking them
+     * to be unblacked and then unblacking them, growing the set of
+     * black pixels reached from the edges a word at a time, or labeling
+     * the black components and clearing those on the border
      */
-    struct Stack* blackedges = createStack(bitmap->width * bitmap->height);
-    store_edges(bitmap, blackedges);
-    unblack_edges(bitmap, blackedges);
+    double start = now();
+    if (strcmp(fill, "words") == 0) {
+        unblack_edges_words(bitmap);
+    } else if (strcmp(fill, "tiles") == 0) {
+        Label_unblack_edges(bitmap, nthreads);
+    } else {
+        struct Stack* blackedges = createStack(2 * (bitmap->width +
+                                                    bitmap->height));
+        store_edges(bitmap, blackedges);
+        report.seeds = blackedges->pushes;
+        lap(&report.seeding, &since);
+        unblack_edges(bitmap, blackedges);
+        report.pushes = blackedges->pushes;
+        report.pops = blackedges->pops;
+        report.peak = blackedges->peak + 1;
+        report.stacked = 1;
+        freeStack(blackedges);
+    }
+    lap(&report.filling, &since);
+    if (throughput)
+        fprintf(stderr, "fill %s: %.3f ms\n", fill, (now() - start) * 1e3);
 
     /* printing every bit of the bitmap to stdout*/
-    pbmwrite(stdout, bitmap);
+    pbmwrite(stdout, bitmap, raw);
+    lap(&report.writing, &since);
+    if (stats)
+        print_stats(stderr, &report);
 
     /* freeing objects and structures, and closing the input file */
     Bit2_free(&bitmap);
-    Pnmrdr_free(&reader);
+    if (fp != stdin) fclose(fp);
+
+    exit(EXIT_SUCCESS);
+}
+
+/* Purpose: pbmread reads a P1 or P4 image into a new Bit2_T with the
+ *          buffered reader in pbm.c, which fills whole words of a row at a
+ *          time. With throughput set, it prints how fast the file was read
+ *          to stderr
+ * I: A file open for reading, positioned at the start of the image, and
+ *    whether to report throughput
+ * O: A new Bit2_T holding the image, or NULL if the file is not a PBM image
+ *    or ends too soon
+ */
+Bit2_T pbmread(FILE *inputfp, int throughput)
+{
+    double start = now();
+    Pbm_T reader = Pbm_open(inputfp);
+    if (reader == NULL) return NULL;
+
+    Bit2_T bitmap = Pbm_read(reader);
+    if (throughput && bitmap != NULL) {
+        double seconds = now() - start;
+        long bytes = Pbm_bytes(reader);
+        fprintf(stderr, "read %s %d x %d: %ld bytes in %.3f ms, "
+                "%.1f MB/s\n", Pbm_raw(reader) ? "P4" : "P1",
+                Pbm_width(reader), Pbm_height(reader), bytes,
+                seconds * 1e3, bytes / seconds / 1e6);
+    }
+    Pbm_close(&reader);
+    return bitmap;
+}
+
+/* Purpose: pbmstream writes the image in a file to stdout with its black
+ *          edge pixels unblackened, reading it twice a row at a time so
+ *          that memory grows with the width, not with the whole image; what
+ *          the first pass learns is kept in temporary files. With
+ *          throughput set, it prints how long that took to stderr
+ * I: A file open for reading, positioned at the start of the image, that
+ *    can seek; 1 for P4 output or 0 for P1; and whether to report the time
+ * O: 0 on success, or -1 after printing why to stderr
+ */
+int pbmstream(FILE *inputfp, int raw, int throughput)
+{
+    double start = now();
+    Pbm_T reader = Pbm_open(inputfp);
+    if (reader == NULL) {
+        fprintf(stderr, "Image is not the correct format\n");
+        return -1;
+    }
+
+    /* the reader is already at the first row, so rewinding it only tells
+     * whether the second pass will be able to
+     */
+    int status = -1;
+    if (Pbm_rewind(reader) != 0)
+        fprintf(stderr, "--stream needs an input file that can seek\n");
+    else if (Label_unblack_stream(reader, stdout, raw) != 0
+             || fflush(stdout) != 0)
+        fprintf(stderr, "Could not stream the image\n");
+    else
+        status = 0;
+
+    if (throughput && status == 0)
+        fprintf(stderr, "stream %d x %d: %.3f ms\n", Pbm_width(reader),
+                Pbm_height(reader), (now() - start) * 1e3);
+    Pbm_close(&reader);
+    return status;
+}
+
+/* Purpose: pbmbatch unblackens the edges of every image named in a list,
+ *          writing each to a directory under the name it had, on a pool of
+ *          workers that each claim the next image when they finish one and
+ *          keep their buffers from image to image. It prints how many
+ *          pages were done and how fast to stderr. A list naming two
+ *          images that would be written to the same name is refused
+ *          before any is read
+ * I: The path of a file naming one image per line, the directory to write
+ *    to, 1 for P4 output or 0 for P1, and the number of workers, or a
+ *    value <= 0 for one per online processor
+ * O: 0 if every image was written, -1 otherwise
+ */
+int pbmbatch(const char *list, const char *out_dir, int raw, int nthreads)
+{
+    struct Batch batch;
+    int k, pages = 0, failed = 0;
+    double start = now();
+
+    batch.paths = read_list(list, &batch.npaths);
+    if (batch.paths == NULL) {
+        fprintf(stderr, "Could not open %s\n", list);
+        return -1;
+    }
+    if (same_names(batch.paths, batch.npaths, out_dir)) {
+        for (k = 0; k < batch.npaths; k++) free(batch.paths[k]);
+        free(batch.paths);
+        return -1;
+    }
+    if (nthreads <= 0) nthreads = Pool_ncpus();
+    batch.next = 0;
+    batch.out_dir = out_dir;
+    batch.raw = raw;
+    batch.workers = (struct Worker *)calloc(nthreads, sizeof(struct Worker));
+    assert(batch.workers);
+
+    Pool_run(Pool_shared(nthreads), nthreads, batch_worker, &batch);
+
+    for (k = 0; k < nthreads; k++) {
+        pages += batch.workers[k].pages;
+        failed += batch.workers[k].failed;
+    }
+    double seconds = now() - start;
+    fprintf(stderr, "batch: %d pages, %d failed, %d workers, %.3f s, "
+            "%.1f pages/s\n", pages, failed, nthreads, seconds,
+            pages / seconds);
+
+    for (k = 0; k < batch.npaths; k++) free(batch.paths[k]);
+    free(batch.paths);
+    free(batch.workers);
+    return failed == 0 ? 0 : -1;
+}
+
+/* Purpose: batch_worker is one worker of a batch. It claims images one at
+ *          a time until none are left, then frees the buffers it kept
+ * I: The worker's number and a void pointer to the batch
+ * O: N/A
+ */
+void batch_worker(int k, void *cl)
+{
+    struct Batch *batch = cl;
+    struct Worker *worker = &batch->workers[k];
+    int n;
+
+    worker->blackedges = createStack(1024);
+    while ((n = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED))
+           < batch->npaths) {
+        if (unblack_file(batch->paths[n], batch, worker) == 0)
+            worker->pages++;
+        else
+            worker->failed++;
+    }
+    freeStack(worker->blackedges);
+    free(worker->words);
+}
+
+/* Purpose: unblack_file unblackens the edges of one image of a batch. The
+ *          image is read into the worker's storage, grown only when an
+ *          image needs more, and filled with the worker's Stack, which is
+ *          empty again after every image
+ * I: The path of the image, a pointer to the batch, and a pointer to the
+ *    worker's buffers
+ * O: 0 if the image was written, or -1 after printing why to stderr
+ */
+int unblack_file(const char *path, struct Batch *batch,
+                 struct Worker *worker)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+    Pbm_T reader = Pbm_open(in);
+    if (reader == NULL) {
+        fprintf(stderr, "%s is not the correct format\n", path);
+        fclose(in);
+        return -1;
+    }
+
+    int width = Pbm_width(reader), height = Pbm_height(reader), j, ok = 1;
+    long size = Bit2_buffer_size(width, height);
+    if (size > worker->size) {
+        free(worker->words);
+        worker->words = (uint64_t *)malloc(size);
+        assert(worker->words);
+        worker->size = size;
+    }
+    Bit2_T bitmap = Bit2_wrap(worker->words, width, height);
+    for (j = 0; j < height && ok; j++)
+        ok = Pbm_read_row(reader, Bit2_row_words(bitmap, j, NULL));
+    Pbm_close(&reader);
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "%s is not the correct format\n", path);
+        Bit2_free(&bitmap);
+        return -1;
+    }
+
+    store_edges(bitmap, worker->blackedges);
+    unblack_edges(bitmap, worker->blackedges);
+
+    const char *name = out_name(path);
+    char *out_path = (char *)malloc(strlen(batch->out_dir) + strlen(name)
+                                    + 2);
+    assert(out_path);
+    sprintf(out_path, "%s/%s", batch->out_dir, name);
+    FILE *out = fopen(out_path, "wb");
+    int status = -1;
+    if (out != NULL) {
+        status = Pbm_write(out, bitmap, batch->raw);
+        if (fclose(out) != 0) status = -1;
+    }
+    if (status != 0) fprintf(stderr, "Could not write %s\n", out_path);
+    free(out_path);
+    Bit2_free(&bitmap);
+    return status;
+}
+
+/* Purpose: read_list reads the paths in a batch list, one to a line of any
+ *          length, with blank lines skipped
+ * I: The path of the list and a pointer to where to store how many paths
+ *    there are
+ * O: A new array of new strings (freed by the caller), or NULL if the list
+ *    could not be opened
+ */
+char **read_list(const char *list, int *npaths)
+{
+    FILE *fp = fopen(list, "r");
+    if (fp == NULL) return NULL;
+
+    int n = 0, max = 64;
+    char **paths = (char **)malloc(max * sizeof(char *));
+    char *line = NULL;
+    size_t line_max = 0;
+    assert(paths);
+    while (getline(&line, &line_max, fp) != -1) {
+        size_t len = strcspn(line, "\r\n");
+        if (len == 0) continue;
+        line[len] = '\0';
+        if (n == max) {
+            max *= 2;
+            paths = (char **)realloc(paths, max * sizeof(char *));
+            assert(paths);
+        }
+        paths[n] = (char *)malloc(len + 1);
+        assert(paths[n]);
+        memcpy(paths[n++], line, len + 1);
+    }
+    free(line);
+    fclose(fp);
+    *npaths = n;
+    return paths;
+}
+
+/* Purpose: out_name returns the name a batch writes an image under, the
+ *          part of its path after the last slash
+ * I: The path of an image
+ * O: A pointer into the path
+ */
+const char *out_name(const char *path)
+{
+    const char *name = strrchr(path, '/');
+    return name == NULL ? path : name + 1;
+}
+
+/* Purpose: same_names checks that no two images of a batch would be
+ *          written to the same file, which two workers could do at once,
+ *          by sorting the paths by out_name and comparing neighbours
+ * I: The paths of a batch, how many there are, and the output directory
+ * O: 1 after printing the first clash to stderr, or 0 if there is none
+ */
+int same_names(char **paths, int npaths, const char *out_dir)
+{
+    char **sorted = (char **)malloc((npaths + 1) * sizeof(char *));
+    int k, clash = 0;
+    assert(sorted);
+    memcpy(sorted, paths, npaths * sizeof(char *));
+    qsort(sorted, npaths, sizeof(char *), compare_names);
+    for (k = 1; k < npaths && !clash; k++) {
+        if (compare_names(&sorted[k - 1], &sorted[k]) == 0) {
+            fprintf(stderr, "%s and %s would both be written to %s/%s\n",
+                    sorted[k - 1], sorted[k], out_dir,
+                    out_name(sorted[k]));
+            clash = 1;
+        }
+    }
+    free(sorted);
+    return clash;
+}
+
+/* Purpose: compare_names orders paths by out_name for qsort
+ * I: Pointers to two paths
+ * O: A negative, zero, or positive int as the first name is less than,
+ *    equal to, or greater than the second
+ */
+int compare_names(const void *a, const void *b)
+{
+    return strcmp(out_name(*(char * const *)a), out_name(*(char * const *)b));
+}
+
+/* Purpose: pbminplace unblackens the edges of a raw (P4) image in its own
+ *          file. The file is mapped shared and the raster after its header
+ *          is filled where it lies by unblack_edges_packed, so the fill
+ *          reads and clears the file's own bytes, and only the pages
+ *          holding a pixel that was cleared are dirtied and written back.
+ *          With throughput set, it prints how long the fill and the write
+ *          back took to stderr
+ * I: The path of a raw PBM file that can be read and written, and whether
+ *    to report the time
+ * O: 0 on success, or -1 after printing why to stderr
+ */
+int pbminplace(const char *path, int throughput)
+{
+    FILE *fp = fopen(path, "r+b");
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+    Pbm_T reader = Pbm_open(fp);
+    if (reader == NULL) {
+        fprintf(stderr, "Image is not the correct format\n");
+        fclose(fp);
+        return -1;
+    }
+    int width = Pbm_width(reader), height = Pbm_height(reader);
+    int raw = Pbm_raw(reader);
+    long offset = Pbm_data_offset(reader);
+    long row_bytes = (width + 7) / 8;
+    Pbm_close(&reader);
+
+    /* the whole raster has to be in the file to be mapped */
+    struct stat st;
+    if (raw == 0) {
+        fprintf(stderr, "--in-place needs a raw (P4) file\n");
+        fclose(fp);
+        return -1;
+    }
+    if (offset < 0 || fstat(fileno(fp), &st) != 0
+        || st.st_size < offset + row_bytes * height) {
+        fprintf(stderr, "Image is not the correct format\n");
+        fclose(fp);
+        return -1;
+    }
+
+    size_t length = offset + row_bytes * height;
+    unsigned char *base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                               MAP_SHARED, fileno(fp), 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Could not map %s\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    double start = now();
+    struct Packed image = { base + offset, row_bytes, width, height };
+    struct Stack* blackedges = createStack(2 * (width + height));
+    unblack_edges_packed(&image, blackedges);
     freeStack(blackedges);
+    double filled = now();
+
+    int status = 0;
+    if (msync(base, length, MS_SYNC) != 0) {
+        fprintf(stderr, "Could not write %s\n", path);
+        status = -1;
+    }
+    if (throughput && status == 0)
+        fprintf(stderr, "in-place %d x %d: %.3f ms fill, %.3f ms sync\n",
+                width, height, (filled - start) * 1e3,
+                (now() - filled) * 1e3);
+    munmap(base, length);
     fclose(fp);
+    return status;
+}
 
-    exit(EXIT_SUCCESS);
+/* Purpose: now returns the current time of a monotonic clock
+ * I: N/A
+ * O: The current time in seconds
+ */
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Purpose: cputime returns the CPU time used by the process so far, in all
+ *          of its threads
+ * I: N/A
+ * O: The CPU time in seconds
+ */
+double cputime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-/* Purpose: pbmread is used as the apply function in map_row_major. Gets the
- *          value of the next bit in the bit map from the Pnmrdr_T object and
- *          applies it to the specified position in the Bit2_T object
- * I: An existing and initailized Bit2_T object, two integers that are both
- *    nonnegative and less than corresponding width and height properties of
- *    the Bit2_T object, an integer representing the stored value at the
- *    [i, j] position of the bitmap, and a void * to any object. i and j
- *    are nonnegative and less than the Bit2_T's width and height respectively
+/* Purpose: lap adds the wall clock and CPU time since a mark to a phase,
+ *          then moves the mark to now
+ * I: A pointer to the phase, or NULL just to set the mark, and a pointer
+ *    to the mark
  * O: N/A
  */
-void pbmread (int i, int j, Bit2_T map, int elem, void *cl)
+void lap(struct Phase *phase, struct Phase *since)
 {
-    (void) elem;
-    assert(i >= 0 && j >= 0);
-    assert(i < map->width && j < map->height);
-    assert(map);
-    Bit2_put(map, i, j, Pnmrdr_get(cl));
+    assert(since);
+    double wall = now(), cpu = cputime();
+    if (phase != NULL) {
+        phase->wall += wall - since->wall;
+        phase->cpu += cpu - since->cpu;
+    }
+    since->wall = wall;
+    since->cpu = cpu;
 }
 
-/* Purpose: store_edges stores all of the black edge pixels in a given image in
- *          a Stack
+/* Purpose: print_stats prints what --stats reports as one line of JSON:
+ *          the fill and image size, the wall and CPU milliseconds of each
+ *          phase, the pixels read, the border seeds, pushes, and pops of
+ *          the Stack and its peak depth, the pushes dropped (0, since the
+ *          Stack grows), and the peak resident set size of the process.
+ *          For fills without a Stack, the seed phase and the Stack's
+ *          counts are null rather than 0, since they do not apply
+ * I: A file open for writing and a pointer to the report
+ * O: N/A
+ */
+void print_stats(FILE *fp, struct Stats *stats)
+{
+    assert(fp && stats);
+    struct rusage usage;
+    long rss_kb = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss
+                                                      : -1;
+    const char *names[] = { "read", "seed", "fill", "write" };
+    struct Phase *phases[] = { &stats->reading, &stats->seeding,
+                               &stats->filling, &stats->writing };
+    int k;
+
+    fprintf(fp, "{\"fill\": \"%s\", \"width\": %d, \"height\": %d, "
+            "\"phases\": {", stats->fill, stats->width, stats->height);
+    for (k = 0; k < 4; k++) {
+        fprintf(fp, "%s\"%s\": ", k == 0 ? "" : ", ", names[k]);
+        if (phases[k] == &stats->seeding && !stats->stacked)
+            fprintf(fp, "null");
+        else
+            fprintf(fp, "{\"wall_ms\": %.3f, \"cpu_ms\": %.3f}",
+                    phases[k]->wall * 1e3, phases[k]->cpu * 1e3);
+    }
+    fprintf(fp, "}, \"pixels_read\": %ld, ",
+            (long)stats->width * stats->height);
+    if (stats->stacked)
+        fprintf(fp, "\"border_seeds\": %ld, \"pushes\": %ld, "
+                "\"pops\": %ld, \"peak_stack\": %ld, \"dropped_pushes\": 0, ",
+                stats->seeds, stats->pushes, stats->pops, stats->peak);
+    else
+        fprintf(fp, "\"border_seeds\": null, \"pushes\": null, "
+                "\"pops\": null, \"peak_stack\": null, "
+                "\"dropped_pushes\": null, ");
+    fprintf(fp, "\"peak_rss_kb\": %ld}\n", rss_kb);
+}
+
+/* Purpose: store_edges stores the black edge pixels in a given image in a
+ *          Stack: one seed for each run of black pixels along the top and
+ *          bottom rows, and every black pixel of the left and right columns
  * I: An existing and initialized Bit2_T object, a Stack pointer for holding
  *    black edge pixels. The Bit2_T object represents a given image
  * O: N/A
@@ -112,28 +742,31 @@ void pbmread (int i, int j, Bit2_T map, int elem, void *cl)
 void store_edges(Bit2_T image, struct Stack* blackedges)
 {
     assert(image);
-    int i, j;
-    for (i = 0; i < Bit2_width(image); i++) {
-        if(Bit2_get(image, i, 0) == 1) push(blackedges, i);
+    int width = Bit2_width(image), height = Bit2_height(image);
+    int j;
+    seed_runs(blackedges, Bit2_row_words(image, 0, NULL), 0, width, 0,
+              width - 1);
+    if (height > 1)
+        seed_runs(blackedges, Bit2_row_words(image, height - 1, NULL),
+                  height - 1, width, 0, width - 1);
 
-        if (Bit2_get(image, i, Bit2_height(image) - 1) == 1)
-            push(blackedges, 
-                 ((Bit2_height(image) - 1) * Bit2_width(image)) + i);
-    }
-
-    for (j = 0; j < Bit2_height(image); j++) {
+    for (j = 1; j < height - 1; j++) {
         if (Bit2_get(image, 0, j) == 1)
-            push(blackedges, (Bit2_width(image) * j));
+            push(blackedges, ((long)width * j));
 
-        if (Bit2_get(image, (Bit2_width(image) - 1), j) == 1)
-            push(blackedges, 
-                 (Bit2_width(image) * j) + (Bit2_width(image) - 1));
+        if (width > 1 && Bit2_get(image, (width - 1), j) == 1)
+            push(blackedges, ((long)width * j) + (width - 1));
     }
 }
 
 /* Purpose: unblack_edges changes any black edge pixel in an image to a white
- *          pixel, by changing a pixel in the Stack to white, checking if its
- *          neighbors are also black, and adding them to the Stack if so
+ *          pixel with a scanline fill. Each seed taken from the Stack is
+ *          widened to the whole run of black pixels around it in its row,
+ *          the run is cleared a word at a time, and one seed is pushed for
+ *          every run of black pixels touching it in the rows above and
+ *          below. A seed whose pixel was already cleared is skipped, so
+ *          every run is filled once and the Stack only ever holds pending
+ *          runs
  * I: An existing and initialized Bit2_T object, A Stack pointer for holding
  *    black edge pixels. The Bit2_T object represents a given image
  * O: N/A
@@ -141,69 +774,423 @@ void store_edges(Bit2_T image, struct Stack* blackedges)
 void unblack_edges(Bit2_T image, struct Stack* blackedges)
 {
     assert(image);
+    int width = Bit2_width(image);
+    int height = Bit2_height(image);
     while (isEmpty(blackedges) == 0) {
-        int cur = pop(blackedges);
-        Bit_put(image->array, cur, 0);
+        long cur = pop(blackedges);
+        int i = cur % width, j = cur / width;
+        uint64_t *row = Bit2_row_words(image, j, NULL);
 
-        // Checks if the pixel to the right (if there is one) is black
-        // Adds to the Stack if so
-        if (cur % Bit2_width(image) < Bit2_width(image) - 1) {
-            if (Bit_get(image->array, cur + 1) == 1) push(blackedges, cur + 1);
-        }
+        // Skips the seed if its run was already cleared
+        if (((row[i / 64] >> (i % 64)) & 1) == 0) continue;
+
+        int l = run_left(row, i), r = run_right(row, i, width);
+        clear_run(row, l, r);
+
+        // Adds a seed for every black run above and below the cleared run
+        if (j > 0)
+            seed_runs(blackedges, Bit2_row_words(image, j - 1, NULL),
+                      j - 1, width, l, r);
+        if (j < height - 1)
+            seed_runs(blackedges, Bit2_row_words(image, j + 1, NULL),
+                      j + 1, width, l, r);
+    }
+}
+
+/* Purpose: unblack_edges_packed changes any black edge pixel in a P4
+ *          raster to a white pixel with the same scanline fill as
+ *          store_edges and unblack_edges, run by run on the raster's own
+ *          bytes. Only bytes holding a black pixel are ever written, so
+ *          nothing outside the cleared components is touched
+ * I: A pointer to the raster, and an empty Stack for the seed pixels
+ * O: N/A
+ */
+void unblack_edges_packed(struct Packed *image, struct Stack* blackedges)
+{
+    assert(image);
+    int width = image->width, height = image->height;
+    long row_bytes = image->row_bytes;
+    int j;
+    packed_seed(blackedges, image->bytes, 0, width, 0, width - 1);
+    if (height > 1)
+        packed_seed(blackedges, image->bytes + (height - 1) * row_bytes,
+                    height - 1, width, 0, width - 1);
+    for (j = 1; j < height - 1; j++) {
+        const unsigned char *row = image->bytes + j * row_bytes;
+        if ((row[0] >> 7) == 1)
+            push(blackedges, ((long)width * j));
+
+        int last = width - 1;
+        if (width > 1 && ((row[last / 8] >> (7 - last % 8)) & 1) == 1)
+            push(blackedges, ((long)width * j) + last);
+    }
+
+    while (isEmpty(blackedges) == 0) {
+        long cur = pop(blackedges);
+        int i = cur % width;
+        j = cur / width;
+        unsigned char *row = image->bytes + j * row_bytes;
+
+        // Skips the seed if its run was already cleared
+        if (((row[i / 8] >> (7 - i % 8)) & 1) == 0) continue;
+
+        int l = packed_left(row, i), r = packed_right(row, i, width);
+        packed_clear(row, l, r);
+
+        // Adds a seed for every black run above and below the cleared run
+        if (j > 0)
+            packed_seed(blackedges, row - row_bytes, j - 1, width, l, r);
+        if (j < height - 1)
+            packed_seed(blackedges, row + row_bytes, j + 1, width, l, r);
+    }
+}
 
-        // Checks if the pixel to the left (if there is one) is black
-        // Adds to the Stack if so
-        if (cur % Bit2_width(image) > 0) {
-            if (Bit_get(image->array, cur - 1) == 1) push(blackedges, cur - 1);
+/* Purpose: unblack_edges_words changes any black edge pixel in an image to
+ *          a white pixel without visiting pixels one at a time. A second
+ *          bit map, reach, starts as the black pixels on the border and is
+ *          grown a word at a time: sweeping down, each row takes in the
+ *          black pixels below reached ones and then spreads along its runs
+ *          of black pixels, and sweeping up does the same from below.
+ *          Sweeps alternate until one changes nothing, and each row keeps
+ *          the range of words that changed since its neighbours last
+ *          looked, so a sweep only touches what is new. Every reached pixel
+ *          is black, so they are then cleared with one Bit2_xor
+ * I: An existing and initialized Bit2_T object representing a given image
+ * O: N/A
+ */
+void unblack_edges_words(Bit2_T image)
+{
+    assert(image);
+    int width = Bit2_width(image), height = Bit2_height(image);
+    int nwords = Bit2_words_per_row(image);
+    Bit2_T reach = Bit2_new(width, height);
+    struct Pending *pending = (struct Pending *)malloc(2 * (size_t)height *
+                                                       sizeof(*pending));
+    uint64_t first = 1, last = 1ULL << ((width - 1) % 64);
+    int j, k, down = 1, sweeps = 0;
+    assert(pending);
+
+    /* the border: all of the top and bottom rows, and the first and last
+     * pixel of every row, each row pending in both directions
+     */
+    for (j = 0; j < height; j++) {
+        uint64_t *black = Bit2_row_words(image, j, NULL);
+        uint64_t *seed = Bit2_row_words(reach, j, NULL);
+        int lo = 0, hi = nwords - 1;
+        if (j == 0 || j == height - 1) {
+            for (k = 0; k < nwords; k++) seed[k] = black[k];
+        } else {
+            seed[0] |= black[0] & first;
+            seed[nwords - 1] |= black[nwords - 1] & last;
         }
+        close_row(seed, black, nwords, &lo, &hi);
+        pending[2 * j] = pending[2 * j + 1] = (struct Pending){ 0, nwords - 1 };
+    }
 
-        // Checks if the pixel below (if there is one) is black
-        // Adds to the Stack if so
-        if (cur < Bit_length(image->array) - Bit2_width(image) - 1) {
-            if (Bit_get(image->array, cur + Bit2_width(image)) == 1)
-                push(blackedges, cur + Bit2_width(image));
+    /* every row of reach is kept closed along its runs, so a sweep that
+     * adds nothing means the fill is done, except for the first one, which
+     * leaves the seeds pending for the sweep up
+     */
+    while (sweep(image, reach, pending, down) || sweeps == 0) {
+        down = !down;
+        sweeps++;
+    }
+
+    Bit2_xor(image, image, reach);
+    Bit2_free(&reach);
+    free(pending);
+}
+
+/* Purpose: sweep passes over the rows of reach once, top to bottom or
+ *          bottom to top, adding to each row the black pixels next to the
+ *          pixels the row before it gained since it was last looked at, and
+ *          closing the row along its runs of black pixels
+ * I: An existing and initialized Bit2_T object representing a given image,
+ *    the Bit2_T of reached pixels (the same size, every row already
+ *    closed), the pending words of each row (pending[2 * j + 1] for the
+ *    row below j and pending[2 * j] for the row above), and 1 to sweep down
+ *    or 0 to sweep up
+ * O: 1 if any row of reach changed, 0 otherwise
+ */
+int sweep(Bit2_T image, Bit2_T reach, struct Pending *pending, int down)
+{
+    int height = Bit2_height(image), nwords = Bit2_words_per_row(image);
+    int step = down ? 1 : -1, j = down ? 1 : height - 2;
+    int n, k, changed = 0;
+
+    for (n = 1; n < height; n++, j += step) {
+        struct Pending *from = &pending[2 * (j - step) + down];
+        if (from->lo > from->hi) continue;
+
+        const uint64_t *before = Bit2_row_words(reach, j - step, NULL);
+        const uint64_t *black = Bit2_row_words(image, j, NULL);
+        uint64_t *row = Bit2_row_words(reach, j, NULL);
+        int lo = nwords, hi = -1;
+        for (k = from->lo; k <= from->hi; k++) {
+            uint64_t word = row[k] | (before[k] & black[k]);
+            if (word != row[k]) {
+                if (lo == nwords) lo = k;
+                hi = k;
+            }
+            row[k] = word;
         }
+        *from = (struct Pending){ nwords, -1 };
+        if (hi >= 0) {
+            close_row(row, black, nwords, &lo, &hi);
+            add_pending(&pending[2 * j], lo, hi);
+            add_pending(&pending[2 * j + 1], lo, hi);
+            changed = 1;
+        }
+    }
+    return changed;
+}
 
-        // Checks if the pixel to above (if there is one) is black
-        // Adds to the Stack if so
-        if (cur >= Bit2_width(image)) {
-            if (Bit_get(image->array, cur - Bit2_width(image)) == 1)
-                push(blackedges, cur - Bit2_width(image));
+/* Purpose: close_row spreads the reached pixels of a row along the runs of
+ *          black pixels that hold them. Words are filled toward their high
+ *          bits and then, going back down the row, toward their low bits;
+ *          within a word the spread takes six shift-and-mask steps of 1, 2,
+ *          4, 8, 16, and 32 pixels, and a run that reaches the end of a
+ *          word carries into the next one. Only the words that gained
+ *          pixels, and those a carry adds pixels to, are looked at
+ * I: The words of a row of reached pixels, the words of the same row of
+ *    the image, how many words there are, and pointers to the first and
+ *    last words that gained pixels since the row was last closed
+ * O: N/A; *lo and *hi are widened to every word the row may have changed in
+ */
+void close_row(uint64_t *reach, const uint64_t *black, int nwords, int *lo,
+               int *hi)
+{
+    uint64_t carry = 0;
+    int k, s;
+    for (k = *lo; k < nwords; k++) {
+        uint64_t in = carry & black[k] & ~reach[k];
+        if (k > *hi && in == 0) break;
+        uint64_t gen = reach[k] | in, prop = black[k];
+        for (s = 1; s < 64; s *= 2) {
+            gen |= prop & (gen << s);
+            prop &= prop << s;
+        }
+        reach[k] = gen;
+        carry = gen >> 63;
+    }
+    *hi = k - 1;
+    carry = 0;
+    for (k = *hi; k >= 0; k--) {
+        uint64_t in = (carry << 63) & black[k] & ~reach[k];
+        if (k < *lo && in == 0) break;
+        uint64_t gen = reach[k] | in, prop = black[k];
+        for (s = 1; s < 64; s *= 2) {
+            gen |= prop & (gen >> s);
+            prop &= prop >> s;
         }
+        reach[k] = gen;
+        carry = gen & 1;
     }
+    *lo = k + 1;
 }
 
-/* Purpose: pbmwrite prints the new pbm file, with its edge pixels
- *          unblackened, as well as its information, to a given output
- * I: An output file/stdout, an existing and initialized Bit2_T object.
- *    The Bit2_T object represents a given image/pbm file.
+/* Purpose: add_pending widens a row's pending words to take in more
+ * I: A pointer to a Pending range and the first and last words to add
  * O: N/A
  */
-void pbmwrite(FILE *outputfp, Bit2_T bitmap)
+void add_pending(struct Pending *pending, int lo, int hi)
 {
-    assert(bitmap);
-    fputs("P1\n", outputfp);    // specifies pbm filetype
-    int width = Bit2_width(bitmap);
-    int height = Bit2_height(bitmap);
-    fprintf(outputfp, "%d %d\n", width, height);   // specifies pbm dimensions
-    Bit2_map_row_major(bitmap, translate, outputfp);    //prints pixels
-    fclose(outputfp);
+    if (lo < pending->lo) pending->lo = lo;
+    if (hi > pending->hi) pending->hi = hi;
+}
+
+/* Purpose: run_left finds where the run of black pixels holding a given
+ *          pixel starts, looking a word at a time for the nearest white
+ *          pixel to its left
+ * I: The words of a row and the column of a black pixel in it
+ * O: The column of the leftmost pixel of the run
+ */
+int run_left(const uint64_t *row, int i)
+{
+    int k = i / 64;
+    uint64_t white = ~row[k] & ((2ULL << (i % 64)) - 1);
+    while (white == 0) {
+        if (--k < 0) return 0;
+        white = ~row[k];
+    }
+    return 64 * k + (63 - clz64(white)) + 1;
 }
 
-/* Purpose: translate prints the individual pixels of a given image to a
- *          specified output.
- * I: A position represented by [i, j], an existing and initialized Bit2_T
- *    object, an int representing an individual pixel to print out, a void
- *    pointer representing the specified output
+/* Purpose: run_right finds where the run of black pixels holding a given
+ *          pixel ends, looking a word at a time for the nearest white pixel
+ *          to its right. The padding past the width is white, so a run
+ *          never goes past the last pixel
+ * I: The words of a row, the column of a black pixel in it, and the width
+ * O: The column of the rightmost pixel of the run
+ */
+int run_right(const uint64_t *row, int i, int width)
+{
+    int k = i / 64, nwords = (width + 63) / 64;
+    uint64_t white = ~row[k] & (~0ULL << (i % 64));
+    while (white == 0) {
+        if (++k == nwords) return width - 1;
+        white = ~row[k];
+    }
+    return 64 * k + ctz64(white) - 1;
+}
+
+/* Purpose: clear_run turns the pixels of a row from one column to another
+ *          white, a word at a time
+ * I: The words of a row and the first and last columns to clear, l <= r
  * O: N/A
  */
-void translate(int i, int j, Bit2_T bit2, int elem, void *cl)
+void clear_run(uint64_t *row, int l, int r)
 {
-    assert(bit2);
-    (void) j;
-    fprintf(cl, "%d", elem);    // prints an individual pixel
-    if (i == Bit2_width(bit2) - 1) fputc(10, cl);   // adds new line
-    else fputc(32, cl);     // adds space
+    int k, first = l / 64, last = r / 64;
+    for (k = first; k <= last; k++) {
+        uint64_t mask = ~0ULL;
+        if (k == first) mask &= ~0ULL << (l % 64);
+        if (k == last) mask &= ~0ULL >> (63 - r % 64);
+        row[k] &= ~mask;
+    }
+}
+
+/* Purpose: seed_runs pushes one seed onto a Stack for each run of black
+ *          pixels in a row that overlaps the columns from l to r. A run
+ *          starts wherever a black pixel has a white (or no) pixel to its
+ *          left within those columns, so the starts of a word are found
+ *          with a shift and taken out with ctz64
+ * I: A Stack pointer, the words of row j, the width, and the first and last
+ *    columns to look at, l <= r
+ * O: N/A
+ */
+void seed_runs(struct Stack* blackedges, const uint64_t *row, int j,
+               int width, int l, int r)
+{
+    int k, first = l / 64, last = r / 64;
+    uint64_t carry = 0;     // whether the pixel left of the word is black
+    for (k = first; k <= last; k++) {
+        uint64_t mask = ~0ULL;
+        if (k == first) mask &= ~0ULL << (l % 64);
+        if (k == last) mask &= ~0ULL >> (63 - r % 64);
+        uint64_t black = row[k] & mask;
+        uint64_t starts = black & ~((black << 1) | carry);
+        carry = black >> 63;
+        while (starts != 0) {
+            push(blackedges, (long)width * j + 64 * k + ctz64(starts));
+            starts &= starts - 1;
+        }
+    }
+}
+
+/* Purpose: packed_left, packed_right, packed_clear, and packed_seed do
+ *          for a row of a P4 raster what run_left, run_right, clear_run,
+ *          and seed_runs do for a row of words, a byte at a time. The bits
+ *          of a byte are in the other order, the leftmost pixel in the
+ *          high bit, so a pixel's left neighbour is the next bit up. The
+ *          bits past the width are not known to be white, so a run is
+ *          never let past the last pixel
+ * I: The bytes of a row, and the same columns (and Stack, row, and width)
+ *    as the word versions
+ * O: The first or last column of a run, or N/A
+ */
+int packed_left(const unsigned char *row, int i)
+{
+    int k = i / 8;
+    unsigned white = ~row[k] & (0xffu << (7 - i % 8)) & 0xff;
+    while (white == 0) {
+        if (--k < 0) return 0;
+        white = ~row[k] & 0xffu;
+    }
+    return 8 * k + (7 - ctz64(white)) + 1;
+}
+
+int packed_right(const unsigned char *row, int i, int width)
+{
+    int k = i / 8, nbytes = (width + 7) / 8;
+    unsigned white = ~row[k] & (0xffu >> (i % 8));
+    while (white == 0) {
+        if (++k == nbytes) return width - 1;
+        white = ~row[k] & 0xffu;
+    }
+    int r = 8 * k + (clz64(white) - 56) - 1;
+    return r < width - 1 ? r : width - 1;
+}
+
+void packed_clear(unsigned char *row, int l, int r)
+{
+    int k, first = l / 8, last = r / 8;
+    for (k = first; k <= last; k++) {
+        unsigned mask = 0xff;
+        if (k == first) mask &= 0xffu >> (l % 8);
+        if (k == last) mask &= 0xffu << (7 - r % 8);
+        row[k] &= ~mask;
+    }
+}
+
+void packed_seed(struct Stack* blackedges, const unsigned char *row, int j,
+                 int width, int l, int r)
+{
+    int k, first = l / 8, last = r / 8;
+    unsigned carry = 0;     // whether the pixel left of the byte is black
+    for (k = first; k <= last; k++) {
+        unsigned mask = 0xff;
+        if (k == first) mask &= 0xffu >> (l % 8);
+        if (k == last) mask &= 0xffu << (7 - r % 8);
+        unsigned black = row[k] & mask;
+        unsigned starts = black & ~((black >> 1) | (carry << 7));
+        carry = black & 1;
+        while (starts != 0) {
+            push(blackedges,
+                 (long)width * j + 8 * k + (7 - ctz64(starts)));
+            starts &= starts - 1;
+        }
+    }
+}
+
+/* Purpose: ctz64 and clz64 count the 0 bits below the lowest 1 bit and
+ *          above the highest 1 bit of a word
+ * I: A nonzero word
+ * O: The number of trailing or leading 0 bits
+ */
+int ctz64(uint64_t word)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int n = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+int clz64(uint64_t word)
+{
+#ifdef __GNUC__
+    return __builtin_clzll(word);
+#else
+    int n = 0;
+    while ((word >> 63) == 0) {
+        word <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* Purpose: pbmwrite prints the new pbm file, with its edge pixels
+ *          unblackened, as well as its information, to a given output, as
+ *          plain P1 text or packed P4 bytes. The output is formatted into
+ *          large buffers by Pbm_write rather than a character at a time
+ * I: An output file/stdout, an existing and initialized Bit2_T object,
+ *    and 1 for P4 or 0 for P1. The Bit2_T object represents a given
+ *    image/pbm file.
+ * O: N/A
+ */
+void pbmwrite(FILE *outputfp, Bit2_T bitmap, int raw)
+{
+    assert(bitmap);
+    if (Pbm_write(outputfp, bitmap, raw) != 0 || fflush(outputfp) != 0)
+        fprintf(stderr, "Could not write the image\n");
+    fclose(outputfp);
 }
 
 /* Purpose: createStack creates a new Stack object and initializes its maximum
@@ -216,7 +1203,10 @@ struct Stack* createStack(unsigned max)
     struct Stack* blackedges = (struct Stack*)malloc(sizeof(struct Stack));
     blackedges->max = max;
     blackedges->head = -1;
-    blackedges->array = (int*)malloc(blackedges->max * sizeof(int));
+    blackedges->peak = -1;
+    blackedges->pushes = 0;
+    blackedges->pops = 0;
+    blackedges->array = (long*)malloc(blackedges->max * sizeof(long));
     return blackedges;
 }
 
@@ -254,29 +1244,40 @@ int isFull(struct Stack* blackedges)
 }
 
 /* Purpose: push inserts a new element as the first element in a given Stack
- *          object, if the Stack isn't already full
- * I: A pointer to an existing and initialized Stack object, an integer to be
- *    inserted
+ *          object, doubling the Stack's memory first if it is full, so no
+ *          element is ever dropped
+ * I: A pointer to an existing and initialized Stack object, a seed index to
+ *    be inserted
  * O: N/A
  */
-void push(struct Stack* blackedges, int elem)
+void push(struct Stack* blackedges, long elem)
 {
     assert(blackedges);
-    if (isFull(blackedges) == 0) blackedges->array[++blackedges->head] = elem;
+    if (isFull(blackedges) == 1) {
+        blackedges->max = 2 * blackedges->max + 1;
+        blackedges->array = (long*)realloc(blackedges->array,
+                                           blackedges->max * sizeof(long));
+        assert(blackedges->array);
+    }
+    blackedges->array[++blackedges->head] = elem;
+    blackedges->pushes++;
+    if (blackedges->head > blackedges->peak)
+        blackedges->peak = blackedges->head;
 }
 
 /* Purpose: pop removes the first element in a given Stack object if the Stack
  *          isn't already empty, and returns it to the user.
  * I: A pointer to an existing and initialized Stack object
- * O: The integer that was removed from the Stack
+ * O: The seed index that was removed from the Stack
  */
-int pop(struct Stack* blackedges)
+long pop(struct Stack* blackedges)
 {
     assert(blackedges);
-    int result = -1;
+    long result = -1;
     if (isEmpty(blackedges) == 0) {
         result = blackedges->array[blackedges->head];
         blackedges->head -= 1;
+        blackedges->pops++;
     }
     return result;
 }